@@ -0,0 +1,164 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <algorithm>
+#include <compare>
+#include <keyrange.h>
+#include <orderedcode.h>
+
+// Abbreviated keys: the first 8 or 16 bytes of an encoded key loaded as big-endian integers, zero-padded.
+// Comparing prefixes orders keys the way compare_keys does except on ties, where the whole keys decide,
+// so most comparisons in a sort or search are one integer compare with no pointer chase.
+namespace orderedcode {
+
+struct prefix128 {
+  uint64_t hi;
+  uint64_t lo;
+
+  friend constexpr auto operator<=>(const prefix128&, const prefix128&) = default;
+};
+
+template<size_t N>
+using key_prefix_t = std::conditional_t<N == 8, uint64_t, prefix128>;
+
+namespace detail {
+
+inline uint64_t load_be64(const byte_t* p, size_t n) {
+  uint64_t x = 0;
+  if (n >= 8) {
+    memcpy(&x, p, sizeof(x));
+    if constexpr (std::endian::native == std::endian::little) {
+#if defined(_MSC_VER) && !defined(__clang__)
+      x = _byteswap_uint64(x);
+#else
+      x = __builtin_bswap64(x);
+#endif
+    }
+    return x;
+  }
+  for (size_t i = 0; i < 8; i++) {
+    x = x << 8 | (i < n ? p[i] : 0);
+  }
+  return x;
+}
+
+}// namespace detail
+
+// The first N bytes of k, N being 8 or 16, as an order-preserving integer.
+template<size_t N = 8>
+key_prefix_t<N> key_prefix(span<const byte_t> k) {
+  static_assert(N == 8 || N == 16, "orderedcode: key prefixes are 8 or 16 bytes");
+  if constexpr (N == 8) {
+    return detail::load_be64(k.data(), k.size());
+  } else {
+    return {detail::load_be64(k.data(), k.size()),
+            k.size() > 8 ? detail::load_be64(k.data() + 8, k.size() - 8) : 0};
+  }
+}
+
+// A key with its prefix stored alongside, so comparisons rarely dereference the key.
+template<size_t N = 8>
+struct abbreviated_key {
+  key_prefix_t<N> prefix;
+  span<const byte_t> key;
+
+  abbreviated_key() = default;
+
+  explicit abbreviated_key(span<const byte_t> k) : prefix(key_prefix<N>(k)), key(k) {}
+};
+
+// Compares the prefixes and, only on a tie, the keys after them.
+struct abbreviated_less {
+  template<size_t N>
+  bool operator()(const abbreviated_key<N>& a, const abbreviated_key<N>& b) const {
+    if (a.prefix != b.prefix) {
+      return a.prefix < b.prefix;
+    }
+    // equal prefixes mean equal leading bytes, unless a key is shorter than N and was padded.
+    size_t d = std::min({N, a.key.size(), b.key.size()});
+    return compare_keys(a.key.subspan(d), b.key.subspan(d)) < 0;
+  }
+};
+
+namespace detail {
+
+template<size_t N>
+struct abbreviated_entry {
+  key_prefix_t<N> prefix;
+  size_t rest;
+  span<const byte_t> key;
+  size_t i;
+};
+
+// Sorts [first, last), whose keys all share their first d bytes, by the N bytes after them and then by
+// how many of those bytes the key has, with N + 1 standing for more. Runs that tie and go on are sorted
+// the same way on the next N bytes, so no comparison ever reads more than a prefix.
+template<size_t N>
+void abbreviated_sort_from(abbreviated_entry<N>* first, abbreviated_entry<N>* last, size_t d) {
+  for (auto* e = first; e != last; e++) {
+    auto k = e->key.subspan(d);
+    e->prefix = key_prefix<N>(k);
+    e->rest = std::min(k.size(), N + 1);
+  }
+  std::sort(first, last, [](const abbreviated_entry<N>& a, const abbreviated_entry<N>& b) {
+    return a.prefix != b.prefix ? a.prefix < b.prefix : a.rest < b.rest;
+  });
+  for (auto* r = first; r != last;) {
+    auto* q = r + 1;
+    while (q != last && q->prefix == r->prefix && q->rest == r->rest) {
+      q++;
+    }
+    if (q - r > 1 && r->rest > N) {
+      abbreviated_sort_from(r, q, d + N);
+    }
+    r = q;
+  }
+}
+
+}// namespace detail
+
+// Sorts encoded keys into byte order like std::sort with key_less, comparing N-byte prefixes taken
+// after the longest prefix all keys share, and breaking ties on the next N bytes rather than with whole
+// key comparisons. The elements may be bytes, spans of bytes or std::string; they are sorted by index
+// and then moved once into place, so large elements are not swapped around.
+template<size_t N = 8, typename It>
+void abbreviated_sort(It first, It last) {
+  size_t n = last - first;
+  if (n < 2) {
+    return;
+  }
+  // bytes shared by every key carry no order, so the prefixes start after them.
+  auto k0 = detail::key_view(first[0]);
+  size_t d = k0.size();
+  for (size_t i = 1; i < n && d > 0; i++) {
+    auto k = detail::key_view(first[i]);
+    k = k.first(std::min(d, k.size()));
+    d = std::mismatch(k.begin(), k.end(), k0.begin()).first - k.begin();
+  }
+  vector<detail::abbreviated_entry<N>> es(n);
+  for (size_t i = 0; i < n; i++) {
+    es[i].key = detail::key_view(first[i]);
+    es[i].i = i;
+  }
+  detail::abbreviated_sort_from(es.data(), es.data() + n, d);
+  using value_type = typename std::iterator_traits<It>::value_type;
+  vector<value_type> sorted;
+  sorted.reserve(n);
+  for (auto& e : es) {
+    sorted.push_back(std::move(first[e.i]));
+  }
+  std::move(sorted.begin(), sorted.end(), first);
+}
+
+}// namespace orderedcode
@@ -0,0 +1,365 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cursor.h>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <orderedcode.h>
+#include <thread>
+#include <utility>
+
+namespace orderedcode {
+
+// Many encoded keys packed into one buffer. Key i is data[offsets[i], offsets[i + 1]).
+struct key_batch {
+  bytes data;
+  vector<size_t> offsets;
+
+  size_t size() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+
+  span<byte_t> operator[](size_t i) {
+    return span<byte_t>(data).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+  }
+};
+
+// One field of every row, encoded in direction dir.
+template<typename T>
+struct column {
+  span<const T> vals;
+  byte_t dir = increasing;
+};
+
+// Decode target for one field of every row, read in direction dir. A null vals skips the field.
+// A string_view column decodes like arena_string: the views borrow from the input where they can and
+// otherwise point into mem, which must be set and which the caller resets once the batch is consumed.
+template<typename T>
+struct column_out {
+  vector<T>* vals;
+  byte_t dir = increasing;
+  arena* mem = nullptr;
+};
+
+// Fixed set of threads that the batch functions and radix_sort can run on, so that a caller making many
+// small calls, such as a bulk loader encoding one block at a time, does not start new threads per call.
+class thread_pool {
+public:
+  // Starts threads - 1 workers, the thread calling run taking the last share; 0 means one per core.
+  explicit thread_pool(size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < threads; i++) {
+      workers_.emplace_back([this] { work(); });
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard l(mu_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& w : workers_) {
+      w.join();
+    }
+  }
+
+  size_t size() const {
+    return workers_.size() + 1;
+  }
+
+  // Runs f(0), ..., f(n - 1) on the workers and the calling thread, returning once all have returned and
+  // rethrowing the first exception. Calls from several threads take turns, and f must not call run on
+  // the same pool.
+  void run(size_t n, std::function<void(size_t)> f) {
+    std::lock_guard turn(run_mu_);
+    {
+      std::lock_guard l(mu_);
+      job_ = std::move(f);
+      n_ = n;
+      next_ = 0;
+      error_ = nullptr;
+      busy_ = workers_.size();
+      gen_++;
+    }
+    wake_.notify_all();
+    drain();
+    std::unique_lock l(mu_);
+    done_.wait(l, [&] { return busy_ == 0; });
+    job_ = nullptr;
+    if (error_) {
+      std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+  }
+
+private:
+  void drain() {
+    for (size_t i; (i = next_++) < n_;) {
+      try {
+        job_(i);
+      } catch (...) {
+        std::lock_guard l(mu_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+      }
+    }
+  }
+
+  void work() {
+    uint64_t seen = 0;
+    std::unique_lock l(mu_);
+    for (;;) {
+      wake_.wait(l, [&] { return stop_ || gen_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = gen_;
+      l.unlock();
+      drain();
+      l.lock();
+      if (--busy_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  vector<std::thread> workers_;
+  std::mutex run_mu_;
+  std::mutex mu_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::function<void(size_t)> job_;
+  size_t n_ = 0;
+  std::atomic<size_t> next_{0};
+  size_t busy_ = 0;
+  uint64_t gen_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+namespace detail {
+
+// Rows per thread below which the batch functions do not bother to split the work.
+constexpr size_t batch_grain = 4096;
+
+// Number of threads to use for n rows, where 0 asks for one per core.
+inline size_t batch_threads(size_t threads, size_t n) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max<size_t>(1, std::min(threads, n / batch_grain));
+}
+
+// Splits [0, n) into threads contiguous chunks and runs f(lo, hi) for each, on pool if there is one and
+// otherwise on a thread of its own per chunk when there is more than one. Rethrows the first exception
+// once all chunks have finished.
+template<typename F>
+void parallel_for(thread_pool* pool, size_t threads, size_t n, F&& f) {
+  if (threads == 1) {
+    f(0, n);
+    return;
+  }
+  if (pool != nullptr) {
+    pool->run(threads, [&](size_t t) { f(n * t / threads, n * (t + 1) / threads); });
+    return;
+  }
+  vector<std::exception_ptr> errors(threads);
+  vector<std::thread> started;
+  for (size_t t = 0; t < threads; t++) {
+    started.emplace_back([&, t] {
+      try {
+        f(n * t / threads, n * (t + 1) / threads);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (auto& th : started) {
+    th.join();
+  }
+  for (auto& err : errors) {
+    if (err) {
+      std::rethrow_exception(err);
+    }
+  }
+}
+
+template<typename T>
+byte_t* put_column(byte_t* p, byte_t* e, const column<T>& c, size_t i) {
+  if (c.dir == increasing) {
+    return put_within<increasing>(p, e, c.vals[i]);
+  }
+  return put_within<decreasing>(p, e, c.vals[i]);
+}
+
+// Stores the encoded size of each row i in [lo, hi) at offsets[i + 1].
+template<typename T, typename... Ts>
+void size_rows(vector<size_t>& offsets, size_t lo, size_t hi, const column<T>& col, const column<Ts>&... cols) {
+  for (size_t i = lo; i < hi; i++) {
+    offsets[i + 1] = encoded_size(col.vals[i]) + (encoded_size(cols.vals[i]) + ... + 0);
+  }
+}
+
+template<typename... Ts>
+void put_rows(key_batch& out, size_t lo, size_t hi, const column<Ts>&... cols) {
+  byte_t* e = out.data.data() + out.offsets[hi];
+  for (size_t i = lo; i < hi; i++) {
+    byte_t* p = out.data.data() + out.offsets[i];
+    ((p = put_column(p, e, cols, i)), ...);
+  }
+}
+
+template<typename T>
+void get_column(span<byte_t>& s, const column_out<T>& c, size_t i) {
+  if (c.vals == nullptr) {
+    check(skip_field<T>(s, c.dir));
+  } else if constexpr (std::is_same_v<T, string_view>) {
+    arena_string a{c.mem, {}};
+    check(try_parse(s, c.dir, a));
+    (*c.vals)[i] = a.val;
+  } else {
+    check(try_parse(s, c.dir, (*c.vals)[i]));
+  }
+}
+
+// Decodes rows [lo, hi), stopping in each key after the first `wanted` fields.
+template<typename... Ts>
+void get_rows(span<byte_t> data, span<const size_t> offsets, size_t lo, size_t hi, size_t wanted,
+              const column_out<Ts>&... cols) {
+  for (size_t i = lo; i < hi; i++) {
+    auto s = data.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    size_t k = 0;
+    ((k++ < wanted && (get_column(s, cols, i), true)) && ...);
+  }
+}
+
+template<typename... Ts>
+void decode_batch_on(thread_pool* pool, span<byte_t> data, span<const size_t> offsets, size_t threads,
+                     const column_out<Ts>&... cols) {
+  size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+  // the offsets come from outside, e.g. an SST block, so a key must not reach past its neighbour or data.
+  if (!offsets.empty() && (!std::is_sorted(offsets.begin(), offsets.end()) || offsets.back() > data.size())) {
+    check(status::corrupt);
+  }
+  size_t wanted = 0;
+  size_t k = 0;
+  bool uses_arena = false;
+  auto want = [&](const auto& c) {
+    k++;
+    if (c.vals != nullptr) {
+      if constexpr (std::is_same_v<typename std::remove_pointer_t<decltype(c.vals)>::value_type, string_view>) {
+        if (c.mem == nullptr) {
+          throw runtime_error("orderedcode: string_view column without an arena");
+        }
+        uses_arena = true;
+      }
+      c.vals->resize(n);
+      wanted = k;
+    }
+  };
+  (want(cols), ...);
+  // an arena is not shared between threads.
+  if (uses_arena) {
+    threads = 1;
+  }
+  parallel_for(pool, batch_threads(threads, n), n,
+               [&](size_t lo, size_t hi) { get_rows(data, offsets, lo, hi, wanted, cols...); });
+}
+
+template<typename T, typename... Ts>
+void encode_batch_on(thread_pool* pool, key_batch& out, size_t threads, const column<T>& col,
+                     const column<Ts>&... cols) {
+  size_t n = col.vals.size();
+  if (((cols.vals.size() != n) || ...)) {
+    throw runtime_error("orderedcode: columns differ in length");
+  }
+  threads = batch_threads(threads, n);
+
+  out.offsets.assign(n + 1, 0);
+  out.data.clear();
+  parallel_for(pool, threads, n, [&](size_t lo, size_t hi) { size_rows(out.offsets, lo, hi, col, cols...); });
+  std::partial_sum(out.offsets.begin(), out.offsets.end(), out.offsets.begin());
+  out.data.resize(out.offsets[n]);
+  // every thread writes only between the offsets of its own rows.
+  parallel_for(pool, threads, n, [&](size_t lo, size_t hi) { put_rows(out, lo, hi, col, cols...); });
+}
+
+}// namespace detail
+
+// Encodes row i of the columns as key i of out, replacing its contents but keeping its capacity.
+// With threads other than 1 the rows are split across that many threads, or one per core for 0, started
+// for this call; pass a thread_pool instead to reuse its threads across calls.
+// The threads size their rows, the sizes are summed into offsets, and the threads then encode their rows
+// straight into their final place, so the result is identical to the single-threaded one.
+template<typename T, typename... Ts>
+void encode_batch(key_batch& out, size_t threads, const column<T>& col, const column<Ts>&... cols) {
+  detail::encode_batch_on(nullptr, out, threads, col, cols...);
+}
+
+template<typename T, typename... Ts>
+void encode_batch(key_batch& out, thread_pool& pool, const column<T>& col, const column<Ts>&... cols) {
+  detail::encode_batch_on(&pool, out, pool.size(), col, cols...);
+}
+
+template<typename T, typename... Ts>
+void encode_batch(key_batch& out, const column<T>& col, const column<Ts>&... cols) {
+  encode_batch(out, 1, col, cols...);
+}
+
+// Decodes the keys data[offsets[i], offsets[i + 1]) into element i of each output column, resizing the
+// column vectors to the number of keys. Skipped columns are stepped over without decoding, and fields
+// after the last wanted column are not looked at. threads and pool work as for encode_batch, except that
+// a batch with string_view columns decodes on one thread since their arenas are not shared.
+template<typename... Ts>
+void decode_batch(span<byte_t> data, span<const size_t> offsets, size_t threads, const column_out<Ts>&... cols) {
+  detail::decode_batch_on(nullptr, data, offsets, threads, cols...);
+}
+
+template<typename... Ts>
+void decode_batch(span<byte_t> data, span<const size_t> offsets, thread_pool& pool, const column_out<Ts>&... cols) {
+  detail::decode_batch_on(&pool, data, offsets, pool.size(), cols...);
+}
+
+template<typename... Ts>
+void decode_batch(span<byte_t> data, span<const size_t> offsets, const column_out<Ts>&... cols) {
+  decode_batch(data, offsets, 1, cols...);
+}
+
+template<typename... Ts>
+void decode_batch(key_batch& kb, size_t threads, const column_out<Ts>&... cols) {
+  decode_batch(kb.data, kb.offsets, threads, cols...);
+}
+
+template<typename... Ts>
+void decode_batch(key_batch& kb, thread_pool& pool, const column_out<Ts>&... cols) {
+  decode_batch(kb.data, kb.offsets, pool, cols...);
+}
+
+template<typename... Ts>
+void decode_batch(key_batch& kb, const column_out<Ts>&... cols) {
+  decode_batch(kb.data, kb.offsets, 1, cols...);
+}
+
+}// namespace orderedcode
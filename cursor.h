@@ -0,0 +1,151 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <array>
+#include <orderedcode.h>
+#include <tuple>
+
+namespace orderedcode {
+
+namespace detail {
+
+// Advances s past one encoded T, looking only at length bytes and terminators.
+template<typename T>
+status skip_field(span<byte_t>& s, byte_t dir) {
+  if constexpr (is_decr<T>::value) {
+    return skip_field<decltype(T::val)>(s, dir ^ 0xff);
+  } else if constexpr (std::is_same_v<T, uint64_t>) {
+    if (s.empty() || (s[0] ^ dir) > 8 || s.size() < 1 + size_t(s[0] ^ dir)) {
+      return status::corrupt;
+    }
+    s = s.subspan(1 + (s[0] ^ dir));
+    return status::ok;
+  } else if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, float64_t>) {
+    if (s.empty()) {
+      return status::corrupt;
+    }
+    byte_t c = s[0] ^ dir;
+    // negative values have their leading bits inverted.
+    byte_t neg = (c & 0x80) == 0 ? 0xff : 0x00;
+    c ^= neg;
+    size_t n = std::countl_one(c);
+    if (c == 0xff) {
+      if (s.size() < 2 || byte_t(s[1] ^ dir ^ neg) > 0xc0) {
+        return status::corrupt;
+      }
+      n = 8 + std::countl_one(byte_t(s[1] ^ dir ^ neg));
+    }
+    if (s.size() < n) {
+      return status::corrupt;
+    }
+    s = s.subspan(n);
+    return status::ok;
+  } else if constexpr (std::is_same_v<T, infinity>) {
+    if (s.size() < 2 || (s[0] ^ dir) != inf[0] || (s[1] ^ dir) != inf[1]) {
+      return status::corrupt;
+    }
+    s = s.subspan(2);
+    return status::ok;
+  } else if constexpr (std::is_same_v<T, string_or_infinity>) {
+    if (s.size() >= 2 && (s[0] ^ dir) == inf[0] && (s[1] ^ dir) == inf[1]) {
+      s = s.subspan(2);
+      return status::ok;
+    }
+    return skip_field<string>(s, dir);
+  } else if constexpr (std::is_same_v<T, trailing_string>) {
+    s = s.subspan(s.size());
+    return status::ok;
+  } else {
+    static_assert(std::is_same_v<T, string> || std::is_same_v<T, string_ref> || std::is_same_v<T, arena_string> ||
+                      std::is_same_v<T, string_view>,
+                  "orderedcode: unknown field type");
+    const byte_t* p = s.data();
+    const byte_t* e = p + s.size();
+    for (;;) {
+      auto c = find_special(p, e);
+      if (e - c < 2) {
+        return status::corrupt;
+      }
+      byte_t c0 = *c ^ dir;
+      byte_t c1 = c[1] ^ dir;
+      if (c0 == 0x00 && c1 == 0x01) {
+        s = s.subspan(c + 2 - s.data());
+        return status::ok;
+      }
+      if ((c0 == 0x00 && c1 != 0xff) || (c0 == 0xff && c1 != 0x00)) {
+        return status::corrupt;
+      }
+      p = c + 2;
+    }
+  }
+}
+
+}// namespace detail
+
+// Advances s past one field of type T without decoding it. decr<T> skips a decreasing T.
+template<typename T>
+status try_skip(span<byte_t>& s) {
+  return detail::skip_field<T>(s, increasing);
+}
+
+template<typename T>
+void skip(span<byte_t>& s) {
+  detail::check(try_skip<T>(s));
+}
+
+// Lazily decodes individual fields of a key with a known tuple shape. Reaching field I only skips over
+// the fields before it, and field boundaries are remembered so later accesses do not rescan.
+// The cursor borrows the key bytes, which must outlive it.
+template<typename... Ts>
+class cursor {
+public:
+  explicit cursor(span<byte_t> s) : s_(s) {}
+
+  // Returns the encoded bytes of field I.
+  template<size_t I>
+  span<byte_t> field() {
+    static_assert(I < sizeof...(Ts));
+    locate(I + 1);
+    return s_.subspan(off_[I], off_[I + 1] - off_[I]);
+  }
+
+  template<size_t I, typename T>
+  void get(T& dst) {
+    auto f = field<I>();
+    parse(f, dst);
+  }
+
+  template<size_t I>
+  std::tuple_element_t<I, std::tuple<Ts...>> get() {
+    std::tuple_element_t<I, std::tuple<Ts...>> v{};
+    get<I>(v);
+    return v;
+  }
+
+private:
+  void locate(size_t n) {
+    static constexpr status (*skips[])(span<byte_t>&) = {&try_skip<Ts>...};
+    for (; known_ < n; known_++) {
+      auto t = s_.subspan(off_[known_]);
+      detail::check(skips[known_](t));
+      off_[known_ + 1] = s_.size() - t.size();
+    }
+  }
+
+  span<byte_t> s_;
+  std::array<size_t, sizeof...(Ts) + 1> off_{};
+  size_t known_ = 0;
+};
+
+}// namespace orderedcode
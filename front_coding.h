@@ -0,0 +1,202 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <keyrange.h>
+#include <orderedcode.h>
+
+// Front-coded blocks of sorted encoded keys.
+//
+// Each entry is varint(shared) varint(unshared) followed by the unshared bytes, where shared is the
+// length of the prefix it has in common with the previous key. Every restart_interval entries the
+// prefix is not shared, which makes those entries restart points that can be decoded on their own.
+// The block ends with the offsets of the restart points and their count, as 32-bit little-endian.
+namespace orderedcode {
+
+namespace detail {
+
+inline void put_varint(bytes& s, uint64_t x) {
+  for (; x >= 0x80; x >>= 7) {
+    s.push_back(static_cast<byte_t>(x | 0x80));
+  }
+  s.push_back(static_cast<byte_t>(x));
+}
+
+inline bool get_varint(span<const byte_t>& s, uint64_t& x) {
+  x = 0;
+  for (size_t i = 0; i < s.size() && i < 10; i++) {
+    x |= uint64_t(s[i] & 0x7f) << (7 * i);
+    if ((s[i] & 0x80) == 0) {
+      s = s.subspan(i + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void put_fixed32(bytes& s, uint32_t x) {
+  for (int i = 0; i < 4; i++) {
+    s.push_back(static_cast<byte_t>(x >> (8 * i)));
+  }
+}
+
+inline uint32_t get_fixed32(const byte_t* p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+}// namespace detail
+
+class block_builder {
+public:
+  explicit block_builder(size_t restart_interval = 16) : restart_interval_(restart_interval) {
+    if (restart_interval_ == 0) {
+      throw runtime_error("orderedcode: restart interval must be positive");
+    }
+  }
+
+  // Appends key, which must not sort before the previous one.
+  void add(span<const byte_t> key) {
+    if (count_ > 0 && compare_keys(key, last_) < 0) {
+      throw runtime_error("orderedcode: keys added out of order");
+    }
+    size_t shared = 0;
+    if (count_ % restart_interval_ == 0) {
+      restarts_.push_back(static_cast<uint32_t>(buf_.size()));
+    } else {
+      auto n = std::min(key.size(), last_.size());
+      while (shared < n && key[shared] == last_[shared]) {
+        shared++;
+      }
+    }
+    detail::put_varint(buf_, shared);
+    detail::put_varint(buf_, key.size() - shared);
+    buf_.insert(buf_.end(), key.begin() + shared, key.end());
+    last_.assign(key.begin(), key.end());
+    count_++;
+  }
+
+  // Returns the finished block and resets the builder for the next one.
+  bytes finish() {
+    for (auto r : restarts_) {
+      detail::put_fixed32(buf_, r);
+    }
+    detail::put_fixed32(buf_, static_cast<uint32_t>(restarts_.size()));
+    bytes block;
+    block.swap(buf_);
+    restarts_.clear();
+    last_.clear();
+    count_ = 0;
+    return block;
+  }
+
+  // Size the block would have if finished now.
+  size_t size() const {
+    return buf_.size() + 4 * (restarts_.size() + 1);
+  }
+
+  bool empty() const {
+    return count_ == 0;
+  }
+
+private:
+  size_t restart_interval_;
+  bytes buf_;
+  vector<uint32_t> restarts_;
+  bytes last_;
+  size_t count_ = 0;
+};
+
+// Iterates the keys of a block built by block_builder. The block must outlive the iterator.
+class block_iterator {
+public:
+  explicit block_iterator(span<const byte_t> block) {
+    if (block.size() < 4) {
+      throw runtime_error("orderedcode: corrupt block");
+    }
+    num_restarts_ = detail::get_fixed32(block.data() + block.size() - 4);
+    if ((block.size() - 4) / 4 < num_restarts_) {
+      throw runtime_error("orderedcode: corrupt block");
+    }
+    data_ = block.first(block.size() - 4 - 4 * size_t(num_restarts_));
+    restarts_ = block.data() + data_.size();
+    seek_to_first();
+  }
+
+  bool valid() const {
+    return valid_;
+  }
+
+  span<const byte_t> key() const {
+    return key_;
+  }
+
+  void next() {
+    if (next_ >= data_.size()) {
+      valid_ = false;
+      return;
+    }
+    auto s = data_.subspan(next_);
+    uint64_t shared;
+    uint64_t unshared;
+    if (!detail::get_varint(s, shared) || !detail::get_varint(s, unshared) || shared > key_.size() ||
+        unshared > s.size()) {
+      throw runtime_error("orderedcode: corrupt block");
+    }
+    key_.resize(shared);
+    key_.insert(key_.end(), s.begin(), s.begin() + unshared);
+    next_ = data_.size() - s.size() + unshared;
+    valid_ = true;
+  }
+
+  void seek_to_first() {
+    seek_to_restart(0);
+  }
+
+  // Positions the iterator at the first key not less than target, or makes it invalid if there is none.
+  void seek(span<const byte_t> target) {
+    // find the last restart point whose key is less than target, then scan forward from it.
+    uint32_t lo = 0;
+    uint32_t hi = num_restarts_;
+    while (hi - lo > 1) {
+      auto mid = lo + (hi - lo) / 2;
+      seek_to_restart(mid);
+      if (valid_ && compare_keys(key_, target) < 0) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    for (seek_to_restart(lo); valid_ && compare_keys(key_, target) < 0;) {
+      next();
+    }
+  }
+
+private:
+  void seek_to_restart(uint32_t i) {
+    key_.clear();
+    next_ = i < num_restarts_ ? detail::get_fixed32(restarts_ + 4 * size_t(i)) : data_.size();
+    if (next_ > data_.size()) {
+      throw runtime_error("orderedcode: corrupt block");
+    }
+    next();
+  }
+
+  span<const byte_t> data_;
+  const byte_t* restarts_;
+  uint32_t num_restarts_;
+  bytes key_;
+  size_t next_ = 0;
+  bool valid_ = false;
+};
+
+}// namespace orderedcode
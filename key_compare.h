@@ -0,0 +1,125 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <keyrange.h>
+#include <orderedcode.h>
+
+// Comparison of an encoded key against typed probe values, without encoding the probe.
+//
+// The key and the probe are walked field by field. Fixed-width fields are encoded onto the stack and
+// compared in one memcmp, and strings are compared run by run against their escaped form, so the walk
+// stops at the first byte that differs and never builds a probe key.
+namespace orderedcode {
+
+namespace detail {
+
+// Compares the n bytes at q with the n bytes at p encoded in direction dir.
+template<byte_t dir>
+int compare_run(const byte_t* q, const byte_t* p, size_t n) {
+  if constexpr (dir == increasing) {
+    int c = n > 0 ? memcmp(q, p, n) : 0;
+    return c < 0 ? -1 : c > 0 ? 1 : 0;
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      if (byte_t b = p[i] ^ dir; q[i] != b) {
+        return q[i] < b ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+}
+
+// Compares the front of k with the n bytes at p encoded in direction dir, consuming them from k when
+// equal. A key that ends first compares less.
+template<byte_t dir>
+int compare_encoded(span<const byte_t>& k, const byte_t* p, size_t n) {
+  size_t m = std::min(n, k.size());
+  if (int c = compare_run<dir>(k.data(), p, m); c != 0) {
+    return c;
+  }
+  if (k.size() < n) {
+    return -1;
+  }
+  k = k.subspan(n);
+  return 0;
+}
+
+// Compares the front of k with the escaped and terminated encoding of x.
+template<byte_t dir>
+int compare_string(span<const byte_t>& k, std::string_view x) {
+  auto s = k;
+  const byte_t* p = reinterpret_cast<const byte_t*>(x.data());
+  const byte_t* e = p + x.size();
+  for (;;) {
+    auto c = find_special(p, e);
+    if (int r = compare_encoded<dir>(s, p, c - p); r != 0) {
+      return r;
+    }
+    // a literal 0x00 or 0xff is escaped, and the end of the string is the terminator.
+    const byte_t* pair = c == e ? term : *c == 0x00 ? lit00 : litff;
+    if (int r = compare_encoded<dir>(s, pair, 2); r != 0) {
+      return r;
+    }
+    if (c == e) {
+      k = s;
+      return 0;
+    }
+    p = c + 1;
+  }
+}
+
+template<byte_t dir, typename T>
+int compare_field(span<const byte_t>& k, const T& x) {
+  if constexpr (is_decr<T>::value) {
+    return compare_field<byte_t(dir ^ 0xff)>(k, x.val);
+  } else if constexpr (std::is_same_v<T, trailing_string>) {
+    return compare_encoded<dir>(k, reinterpret_cast<const byte_t*>(x.data()), x.size());
+  } else if constexpr (std::is_same_v<T, string_or_infinity>) {
+    return x.inf ? compare_field<dir>(k, infinity{}) : compare_string<dir>(k, x.s);
+  } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    return compare_string<dir>(k, x);
+  } else {
+    byte_t buf[max_size<T>::value + put_slack];
+    byte_t* e = put<dir>(buf, x);
+    return compare_encoded<increasing>(k, buf, e - buf);
+  }
+}
+
+template<typename It, typename... Its>
+int compare_fields(span<const byte_t>& k, const It& it, const Its&... its) {
+  int c = 0;
+  (void) ((c = compare_field<increasing>(k, it)) == 0 && (((c = compare_field<increasing>(k, its)) == 0) && ...));
+  return c;
+}
+
+}// namespace detail
+
+// Returns the sign of compare_keys(key, k) for the key k that append would encode from the probe
+// fields. A key that goes on past the probe compares greater, so this orders keys the way seeks do.
+template<typename It, typename... Its>
+int compare(span<const byte_t> key, const It& it, const Its&... its) {
+  if (int c = detail::compare_fields(key, it, its...); c != 0) {
+    return c;
+  }
+  return key.empty() ? 0 : 1;
+}
+
+// Like compare, but a key that starts with the probe fields compares equal, which suits matching on
+// leading fields as in a merge join.
+template<typename It, typename... Its>
+int compare_prefix(span<const byte_t> key, const It& it, const Its&... its) {
+  return detail::compare_fields(key, it, its...);
+}
+
+}// namespace orderedcode
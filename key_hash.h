@@ -0,0 +1,161 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <orderedcode.h>
+
+// Encoding fused with hashing, for routing keys to shards without a second pass over the bytes.
+//
+// The hash is a function of the encoded bytes alone: append_hashed returns hash_key of what it wrote,
+// however the key was split into fields, so a router that only has the stored key computes the same
+// value. It is a 64-bit non-cryptographic hash with full avalanche, stable across platforms.
+namespace orderedcode {
+
+namespace detail {
+
+inline uint64_t load_le64(const byte_t* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  if constexpr (std::endian::native == std::endian::big) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    x = _byteswap_uint64(x);
+#else
+    x = __builtin_bswap64(x);
+#endif
+  }
+  return x;
+}
+
+// Streaming hash over 8-byte little-endian words, with the rounds and final mix of xxHash64. The input
+// is read from a contiguous buffer as it grows: update consumes the whole words written so far and
+// returns where the rest starts, and finish hashes that rest without consuming it, so a hash of the
+// bytes up to any point is available in passing.
+class hasher {
+public:
+  explicit hasher(uint64_t seed = 0) : h_(seed + p5) {}
+
+  const byte_t* update(const byte_t* p, const byte_t* e) {
+    for (; e - p >= 8; p += 8) {
+      h_ ^= std::rotl(load_le64(p) * p2, 31) * p1;
+      h_ = std::rotl(h_, 27) * p1 + p4;
+      size_ += 8;
+    }
+    return p;
+  }
+
+  // Hash of everything consumed followed by the fewer than 8 bytes [p, e).
+  uint64_t finish(const byte_t* p, const byte_t* e) const {
+    uint64_t x = h_ + size_ + (e - p);
+    if (p != e) {
+      uint64_t w = 0;
+      for (int i = 0; p + i != e; i++) {
+        w |= uint64_t(p[i]) << (8 * i);
+      }
+      x ^= std::rotl(w * p2, 31) * p1;
+      x = std::rotl(x, 27) * p1 + p4;
+    }
+    x ^= x >> 33;
+    x *= p2;
+    x ^= x >> 29;
+    x *= p3;
+    x ^= x >> 32;
+    return x;
+  }
+
+private:
+  static constexpr uint64_t p1 = 0x9e3779b185ebca87;
+  static constexpr uint64_t p2 = 0xc2b2ae3d27d4eb4f;
+  static constexpr uint64_t p3 = 0x165667b19e3779f9;
+  static constexpr uint64_t p4 = 0x85ebca77c2b2ae63;
+  static constexpr uint64_t p5 = 0x27d4eb2f165667c5;
+
+  uint64_t h_;
+  uint64_t size_ = 0;
+};
+
+}// namespace detail
+
+// Hash of an encoded key, or of any prefix of one.
+inline uint64_t hash_key(span<const byte_t> k, uint64_t seed = 0) {
+  detail::hasher h(seed);
+  const byte_t* e = k.data() + k.size();
+  return h.finish(h.update(k.data(), e), e);
+}
+
+// full hashes the whole key; prefix hashes the bytes of its first K fields, for partitioning where keys
+// sharing those fields must land together.
+struct key_hash {
+  uint64_t full;
+  uint64_t prefix;
+};
+
+// Seed for append_hashed, the counterpart of hash_key's seed. It is passed before the fields, since a
+// parameter cannot follow them, and is a type of its own so it is not taken for a uint64_t field.
+struct hash_seed {
+  uint64_t val = 0;
+};
+
+// Appends the fields like append, feeding each field's bytes to the hasher right after they are written
+// while they are still in cache, and takes the prefix hash in passing at the end of field K. The result
+// equals hash_key of the appended bytes and of the first K fields' bytes, with the same seed.
+template<size_t K = 0, sink S, typename It, typename... Its>
+key_hash append_hashed(S& s, hash_seed seed, const It& it, const Its&... its) {
+  static_assert(K <= 1 + sizeof...(Its), "orderedcode: prefix has more fields than the key");
+  auto r = s.prepare(encoded_size(it, its...));
+  byte_t* p = r.data();
+  byte_t* e = p + r.size();
+  detail::hasher h(seed.val);
+  const byte_t* t = p;
+  key_hash out{};
+  size_t i = 0;
+  auto field = [&](const auto& x) {
+    if (i++ == K) {
+      out.prefix = h.finish(t, p);
+    }
+    p = detail::put_within(p, e, x);
+    t = h.update(t, p);
+  };
+  try {
+    field(it);
+    (field(its), ...);
+  } catch (...) {
+    s.commit(r.data());
+    throw;
+  }
+  out.full = h.finish(t, p);
+  if (i == K) {
+    out.prefix = out.full;
+  }
+  s.commit(p);
+  return out;
+}
+
+template<size_t K = 0, sink S, typename It, typename... Its>
+key_hash append_hashed(S& s, const It& it, const Its&... its) {
+  return append_hashed<K>(s, hash_seed{}, it, its...);
+}
+
+// The container overloads take the fields with or without a leading hash_seed.
+template<size_t K = 0, typename... Args>
+key_hash append_hashed(bytes& s, const Args&... args) {
+  container_sink<bytes> k{s};
+  return append_hashed<K>(k, args...);
+}
+
+template<size_t K = 0, typename... Args>
+key_hash append_hashed(std::string& s, const Args&... args) {
+  container_sink<std::string> k{s};
+  return append_hashed<K>(k, args...);
+}
+
+}// namespace orderedcode
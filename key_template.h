@@ -0,0 +1,188 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <functional>
+#include <optional>
+#include <orderedcode.h>
+
+// Prepared key templates: leading fields encoded once, with the fields that change per key stamped
+// after them into a reused buffer.
+namespace orderedcode {
+
+class key_template {
+public:
+  key_template() = default;
+
+  template<typename... Ts>
+  explicit key_template(const Ts&... prefix) {
+    reset(prefix...);
+  }
+
+  // Replaces the leading fields, keeping the buffer.
+  template<typename... Ts>
+  void reset(const Ts&... prefix) {
+    kb_.clear();
+    if constexpr (sizeof...(prefix) > 0) {
+      kb_.append(prefix...);
+    }
+    mark_ = kb_.mark();
+  }
+
+  span<const byte_t> prefix() const {
+    return kb_.key().first(mark_);
+  }
+
+  // Returns the leading fields followed by suffix. Only the suffix is encoded, and the view is valid
+  // until the next stamp or reset.
+  template<typename It, typename... Its>
+  span<byte_t> stamp(const It& it, const Its&... its) {
+    kb_.truncate(mark_);
+    kb_.append(it, its...);
+    return kb_.key();
+  }
+
+  // Appends the leading fields and suffix to another sink, such as an arena or a batch buffer.
+  template<sink S, typename It, typename... Its>
+  void stamp_to(S& s, const It& it, const Its&... its) const {
+    auto p = prefix();
+    auto r = s.prepare(p.size() + encoded_size(it, its...));
+    memcpy(r.data(), p.data(), p.size());
+    buffer_sink rest{r.subspan(p.size())};
+    try {
+      append(rest, it, its...);
+    } catch (...) {
+      s.commit(r.data());
+      throw;
+    }
+    s.commit(r.data() + p.size() + rest.size);
+  }
+
+private:
+  key_builder kb_;
+  size_t mark_ = 0;
+};
+
+namespace detail {
+
+// Type a leading value is kept as in a template cache: string-likes are owned, also under decr, and the
+// rest are kept as given.
+template<typename T>
+struct cached {
+  using type = std::conditional_t<std::is_convertible_v<const T&, std::string_view>, std::string, T>;
+};
+
+template<typename T>
+struct cached<decr<T>> {
+  using type = decr<typename cached<T>::type>;
+};
+
+template<typename T>
+using cached_t = typename cached<T>::type;
+
+template<typename T>
+cached_t<T> to_cached(const T& x) {
+  if constexpr (is_decr<T>::value) {
+    return {to_cached(x.val)};
+  } else {
+    return cached_t<T>(x);
+  }
+}
+
+template<typename T>
+size_t hash_value(const T& x) {
+  if constexpr (is_decr<T>::value) {
+    return ~hash_value(x.val);
+  } else if constexpr (std::is_same_v<T, infinity>) {
+    return 0x9e3779b97f4a7c15;
+  } else if constexpr (std::is_same_v<T, string_or_infinity>) {
+    return x.inf ? hash_value(infinity{}) : std::hash<std::string_view>{}(x.s);
+  } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    return std::hash<std::string_view>{}(x);
+  } else {
+    return std::hash<T>{}(x);
+  }
+}
+
+template<typename A, typename B>
+bool same_value(const A& a, const B& b) {
+  if constexpr (is_decr<A>::value) {
+    return same_value(a.val, b.val);
+  } else if constexpr (std::is_same_v<A, string_or_infinity>) {
+    return a.inf == b.inf && (a.inf || a.s == b.s);
+  } else {
+    return a == b;
+  }
+}
+
+}// namespace detail
+
+// Small direct-mapped cache of templates keyed by their leading values, for a hot path whose leading
+// fields take few distinct values. A miss re-encodes the evicted slot in place, keeping its buffer, so
+// the cache stamps in the same call that looks the template up and never hands out a slot that a later
+// lookup could change. It is not synchronized: use one per thread, e.g. through thread_key_templates.
+template<typename... Ts>
+class key_template_cache {
+public:
+  // slots is rounded up to a power of two.
+  explicit key_template_cache(size_t slots = 64) : slots_(std::bit_ceil(std::max<size_t>(slots, 1))) {}
+
+  // Returns the leading values followed by suffix, encoding the leading values only when their slot
+  // holds others. The view is valid until the next stamp on this cache; copy it, or use stamp_to, to keep
+  // the key while stamping another.
+  template<typename... Us>
+  span<byte_t> stamp(const Ts&... prefix, const Us&... suffix) {
+    return lookup(prefix...).stamp(suffix...);
+  }
+
+  // Appends the leading values and suffix to another sink.
+  template<sink S, typename... Us>
+  void stamp_to(S& s, const Ts&... prefix, const Us&... suffix) {
+    lookup(prefix...).stamp_to(s, suffix...);
+  }
+
+private:
+  using values_type = std::tuple<detail::cached_t<Ts>...>;
+
+  struct slot {
+    std::optional<values_type> values;
+    key_template t;
+  };
+
+  key_template& lookup(const Ts&... prefix) {
+    size_t h = 0;
+    ((h = (h ^ detail::hash_value(prefix)) * 0x100000001b3), ...);
+    auto& s = slots_[(h ^ h >> 32) & (slots_.size() - 1)];
+    if (!s.values || !values_equal(*s.values, prefix...)) {
+      s.values.emplace(detail::to_cached(prefix)...);
+      s.t.reset(prefix...);
+    }
+    return s.t;
+  }
+
+  static bool values_equal(const values_type& v, const Ts&... prefix) {
+    return std::apply([&](const auto&... xs) { return (detail::same_value(xs, prefix) && ...); }, v);
+  }
+
+  vector<slot> slots_;
+};
+
+// The calling thread's cache for leading values of types Ts, e.g.
+// thread_key_templates<uint64_t, std::string>().stamp(tenant, table, ts).
+template<typename... Ts>
+key_template_cache<Ts...>& thread_key_templates() {
+  thread_local key_template_cache<Ts...> cache;
+  return cache;
+}
+
+}// namespace orderedcode
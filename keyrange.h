@@ -0,0 +1,94 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <orderedcode.h>
+
+namespace orderedcode {
+
+// Half-open range [lo, hi) of encoded keys. An empty hi means the range has no upper bound.
+struct key_range {
+  bytes lo;
+  bytes hi;
+};
+
+// Orders encoded keys the way they are meant to be compared: bytewise, shorter first on a tie.
+inline int compare_keys(span<const byte_t> a, span<const byte_t> b) {
+  auto n = std::min(a.size(), b.size());
+  if (n > 0) {
+    if (auto c = memcmp(a.data(), b.data(), n); c != 0) {
+      return c < 0 ? -1 : 1;
+    }
+  }
+  return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+}
+
+namespace detail {
+
+// Bytes of a key held as bytes, a span of bytes or std::string, for code that accepts any of them.
+inline span<const byte_t> key_view(const bytes& k) {
+  return k;
+}
+
+inline span<const byte_t> key_view(span<const byte_t> k) {
+  return k;
+}
+
+inline span<const byte_t> key_view(span<byte_t> k) {
+  return k;
+}
+
+inline span<const byte_t> key_view(const std::string& k) {
+  return {reinterpret_cast<const byte_t*>(k.data()), k.size()};
+}
+
+}// namespace detail
+
+struct key_less {
+  bool operator()(span<const byte_t> a, span<const byte_t> b) const {
+    return compare_keys(a, b) < 0;
+  }
+};
+
+// Returns the smallest key greater than every key that starts with prefix, or an empty key if there is
+// none, i.e. the prefix is empty or all 0xff.
+inline bytes prefix_successor(span<const byte_t> prefix) {
+  bytes s(prefix.begin(), prefix.end());
+  while (!s.empty() && s.back() == 0xff) {
+    s.pop_back();
+  }
+  if (!s.empty()) {
+    s.back()++;
+  }
+  return s;
+}
+
+// Returns the keys whose leading fields are the given tuple. Every field encoding but trailing_string is
+// prefix-free, so these are exactly the keys that start with its encoding, whatever the direction of each
+// field. A trailing_string, which can only come last, instead matches every key whose trailing part
+// starts with it.
+template<typename... Ts>
+key_range prefix_range(const Ts&... prefix) {
+  key_range r;
+  if constexpr (sizeof...(prefix) > 0) {
+    append(r.lo, prefix...);
+  }
+  r.hi = prefix_successor(r.lo);
+  return r;
+}
+
+inline bool contains(const key_range& r, span<const byte_t> key) {
+  return compare_keys(r.lo, key) <= 0 && (r.hi.empty() || compare_keys(key, r.hi) < 0);
+}
+
+}// namespace orderedcode
@@ -12,12 +12,31 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#if !defined(ORDEREDCODE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define ORDEREDCODE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define ORDEREDCODE_TARGET_AVX2
+#else
+#define ORDEREDCODE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace orderedcode {
 
 using namespace std;
@@ -26,14 +45,13 @@ using byte_t = unsigned char;
 using bytes = std::vector<byte_t>;
 using float64_t = double_t;
 
-const byte_t term[] = {0x00, 0x01};
-const byte_t lit00[] = {0x00, 0xff};
-const byte_t litff[] = {0xff, 0x00};
-const byte_t inf[] = {0xff, 0xff};
-const byte_t msb[] = {0x00, 0x80, 0xc0, 0xe0, 0xf0, 0xf8, 0xfc, 0xfe};
+constexpr byte_t term[] = {0x00, 0x01};
+constexpr byte_t lit00[] = {0x00, 0xff};
+constexpr byte_t litff[] = {0xff, 0x00};
+constexpr byte_t inf[] = {0xff, 0xff};
 
-const byte_t increasing = 0x00;
-const byte_t decreasing = 0xff;
+constexpr byte_t increasing = 0x00;
+constexpr byte_t decreasing = 0xff;
 
 struct infinity {
   bool operator==(const infinity& i) const {
@@ -58,6 +76,16 @@ struct decr {
   }
 };
 
+namespace detail {
+
+template<typename T>
+struct is_decr : std::false_type {};
+
+template<typename T>
+struct is_decr<decr<T>> : std::true_type {};
+
+}// namespace detail
+
 struct string_or_infinity {
   string s;
   bool inf;
@@ -65,96 +93,453 @@ struct string_or_infinity {
 
 struct trailing_string : string {};
 
-void invert(span<byte_t>& s) {
-  std::for_each(s.begin(), s.end(), [](byte_t& c) { c ^= 0xff; });
+// Decode target that avoids copying: val borrows from the parsed input when the encoded string is
+// increasing and has no escapes. Otherwise the value is unescaped into scratch, val points at scratch
+// and copied is set. Reusing one string_ref across calls keeps the capacity of scratch. A copy or move of
+// a copied value points at its own scratch.
+struct string_ref {
+  string_view val;
+  string scratch;
+  bool copied = false;
+
+  string_ref() = default;
+
+  string_ref(const string_ref& o) : val(o.val), scratch(o.scratch), copied(o.copied) {
+    repoint();
+  }
+
+  string_ref(string_ref&& o) noexcept : val(o.val), scratch(std::move(o.scratch)), copied(o.copied) {
+    repoint();
+    o.val = {};
+  }
+
+  string_ref& operator=(const string_ref& o) {
+    scratch = o.scratch;
+    val = o.val;
+    copied = o.copied;
+    repoint();
+    return *this;
+  }
+
+  string_ref& operator=(string_ref&& o) noexcept {
+    scratch = std::move(o.scratch);
+    val = o.val;
+    copied = o.copied;
+    repoint();
+    o.val = {};
+    return *this;
+  }
+
+private:
+  void repoint() {
+    if (copied) {
+      val = scratch;
+    }
+  }
+};
+
+namespace detail {
+
+// Stores x at p as 8 big-endian bytes.
+constexpr void store_be64(byte_t* p, uint64_t x) {
+  if (std::is_constant_evaluated()) {
+    for (int i = 0; i < 8; i++) {
+      p[i] = static_cast<byte_t>(x >> (56 - 8 * i));
+    }
+    return;
+  }
+  if constexpr (std::endian::native == std::endian::little) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    x = _byteswap_uint64(x);
+#else
+    x = __builtin_bswap64(x);
+#endif
+  }
+  memcpy(p, &x, sizeof(x));
 }
 
-void append(bytes& s, uint64_t x) {
-  vector<byte_t> buf(9);
-  auto i = 8;
-  for (; x > 0; x >>= 8) {
-    buf[i--] = static_cast<byte_t>(x);
+// The find_special family returns the first byte in [p, e) that is 0x00 or 0xff, or e if there is none.
+// Both values are closed under XOR with a direction byte, so the same scan serves either direction.
+using find_special_fn = const byte_t* (*)(const byte_t*, const byte_t*);
+
+inline const byte_t* find_special_scalar(const byte_t* p, const byte_t* e) {
+  for (; p < e; p++) {
+    if (byte_t(*p + 1) <= 1) {
+      return p;
+    }
   }
-  buf[i] = static_cast<byte_t>(8 - i);
-  s.insert(s.end(), buf.begin() + i, buf.end());
+  return e;
 }
 
-void append(bytes& s, int64_t x) {
-  if (x >= -64 && x < 64) {
-    s.insert(s.end(), static_cast<byte_t>(x ^ 0x80));
-    return;
+#ifdef ORDEREDCODE_X86
+inline const byte_t* find_special_sse2(const byte_t* p, const byte_t* e) {
+  const __m128i lo = _mm_setzero_si128();
+  const __m128i hi = _mm_set1_epi8(-1);
+  for (; e - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto m = unsigned(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lo), _mm_cmpeq_epi8(v, hi))));
+    if (m != 0) {
+      return p + std::countr_zero(m);
+    }
   }
-  bool neg = x < 0;
-  if (neg) {
-    x = ~x;
+  return find_special_scalar(p, e);
+}
+
+ORDEREDCODE_TARGET_AVX2 inline const byte_t* find_special_avx2(const byte_t* p, const byte_t* e) {
+  const __m256i lo = _mm256_setzero_si256();
+  const __m256i hi = _mm256_set1_epi8(-1);
+  for (; e - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto m = unsigned(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lo), _mm256_cmpeq_epi8(v, hi))));
+    if (m != 0) {
+      return p + std::countr_zero(m);
+    }
   }
-  auto n = 1;
-  bytes buf(10);
-  auto i = 9;
-  for (; x > 0; x >>= 8) {
-    buf[i--] = static_cast<byte_t>(x);
-    n++;
+  return find_special_sse2(p, e);
+}
+
+inline bool has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int r[4];
+  __cpuid(r, 0);
+  if (r[0] < 7) {
+    return false;
   }
-  bool lfb = n > 7;
-  if (lfb) {
-    n -= 7;
+  __cpuid(r, 1);
+  // OSXSAVE and AVX, then check that the OS saves the ymm state.
+  if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
   }
-  if (buf[i + 1] < 1 << (8 - n)) {
-    n--;
-    i++;
+  __cpuidex(r, 7, 0);
+  return (r[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+inline find_special_fn select_find_special() {
+#ifdef ORDEREDCODE_X86
+  return has_avx2() ? find_special_avx2 : find_special_sse2;
+#else
+  return find_special_scalar;
+#endif
+}
+
+inline const byte_t* find_special(const byte_t* p, const byte_t* e) {
+  if (e - p < 16) {
+    return find_special_scalar(p, e);
+  }
+  static const find_special_fn fn = select_find_special();
+  return fn(p, e);
+}
+
+// Copies n bytes from src to dst XORing each with dir. dst may be src but must not overlap it otherwise.
+inline void copy_xor(byte_t* dst, const byte_t* src, size_t n, byte_t dir) {
+  if (dir == increasing) {
+    if (dst != src) {
+      memcpy(dst, src, n);
+    }
+    return;
   }
-  buf[i] |= msb[n];
-  if (lfb) {
-    buf[--i] = 0xff;
+  size_t i = 0;
+#ifdef ORDEREDCODE_X86
+  const __m128i m = _mm_set1_epi8(static_cast<char>(dir));
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, m));
   }
-  if (neg) {
-    span<byte_t> sp(&buf[i], buf.size() - i);
-    invert(sp);
+#endif
+  const uint64_t w = 0x0101010101010101ULL * dir;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t v;
+    memcpy(&v, src + i, 8);
+    v ^= w;
+    memcpy(dst + i, &v, 8);
+  }
+  for (; i < n; i++) {
+    dst[i] = src[i] ^ dir;
   }
-  s.insert(s.end(), buf.begin() + i, buf.end());
 }
 
-void append(bytes& s, float64_t x) {
-  if (isnan(x)) {
-    throw runtime_error("append: NaN");
+// Appends [p, e) to dst with every byte XORed with dir.
+inline void append_xor(string& dst, const byte_t* p, const byte_t* e, byte_t dir) {
+  if (dir == increasing) {
+    dst.append(reinterpret_cast<const char*>(p), e - p);
+    return;
+  }
+  auto o = dst.size();
+  dst.resize(o + (e - p));
+  copy_xor(reinterpret_cast<byte_t*>(&dst[o]), p, e - p, dir);
+}
+
+// put writes the encoding of x at p in direction dir and returns its end. The XOR with dir is applied
+// while writing, so decr<T> costs no extra pass. For the fixed-width types put may store up to
+// put_slack bytes, so p must have that much room even when the encoding is shorter.
+constexpr size_t put_slack = 10;
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, uint64_t x) {
+  constexpr uint64_t mask = dir == increasing ? 0 : ~uint64_t(0);
+  if (x == 0) {
+    *p = 0x00 ^ dir;
+    return p + 1;
   }
-  uint64_t b;
-  memcpy(&b, &x, sizeof(x));
-  auto i = int64_t(b);
+  auto n = (64 - std::countl_zero(x) + 7) / 8;
+  // one length byte plus an unconditional 8-byte store.
+  p[0] = static_cast<byte_t>(n ^ dir);
+  store_be64(p + 1, (x << (64 - 8 * n)) ^ mask);
+  return p + 1 + n;
+}
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, int64_t x) {
+  if (x >= -64 && x < 64) {
+    *p = static_cast<byte_t>(x ^ 0x80 ^ dir);
+    return p + 1;
+  }
+  // negative values are encoded as the inverse of their one's complement.
+  uint64_t neg = x < 0 ? ~uint64_t(0) : 0;
+  uint64_t u = uint64_t(x) ^ neg;
+  // n bytes carry n leading 1 bits, a 0 bit and 7n-1 bits of magnitude.
+  auto n = (64 - std::countl_zero(u) + 7) / 7;
+  uint64_t mask = dir == increasing ? neg : ~neg;
+  if (n <= 8) {
+    store_be64(p, ((u << (64 - 8 * n)) | (~uint64_t(0) << (64 - n))) ^ mask);
+  } else if (n == 9) {
+    p[0] = static_cast<byte_t>(0xff ^ mask);
+    store_be64(p + 1, (u | uint64_t(1) << 63) ^ mask);
+  } else {
+    p[0] = static_cast<byte_t>(0xff ^ mask);
+    p[1] = static_cast<byte_t>(0xc0 ^ mask);
+    store_be64(p + 2, u ^ mask);
+  }
+  return p + n;
+}
+
+// Maps a float onto an int64 with the same order.
+constexpr int64_t float_bits(float64_t x) {
+  auto i = std::bit_cast<int64_t>(x);
   if (i < 0) {
     i = std::numeric_limits<int64_t>::min() - i;
   }
-  append(s, i);
+  return i;
 }
 
-void append(bytes& s, const std::string& x) {
-  auto l = x.begin();
-  for (auto c = x.begin(); c < x.end(); c++) {
-    switch (byte_t(*c)) {
-      case 0x00:
-        s.insert(s.end(), l, c);
-        s.insert(s.end(), &lit00[0], &lit00[0] + 2);
-        l = c + 1;
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, float64_t x) {
+  if (x != x) {
+    throw runtime_error("append: NaN");
+  }
+  return put<dir>(p, float_bits(x));
+}
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, std::string_view x) {
+  if (std::is_constant_evaluated()) {
+    for (char ch : x) {
+      auto c = static_cast<byte_t>(ch);
+      if (c == 0x00 || c == 0xff) {
+        auto lit = c == 0x00 ? lit00 : litff;
+        *p++ = lit[0] ^ dir;
+        *p++ = lit[1] ^ dir;
+      } else {
+        *p++ = c ^ dir;
+      }
+    }
+  } else {
+    auto q = reinterpret_cast<const byte_t*>(x.data());
+    auto e = q + x.size();
+    for (;;) {
+      auto c = find_special(q, e);
+      copy_xor(p, q, c - q, dir);
+      p += c - q;
+      if (c == e) {
         break;
-      case 0xff:
-        s.insert(s.end(), l, c);
-        s.insert(s.end(), &litff[0], &litff[0] + 2);
-        l = c + 1;
+      }
+      auto lit = *c == 0x00 ? lit00 : litff;
+      p[0] = lit[0] ^ dir;
+      p[1] = lit[1] ^ dir;
+      p += 2;
+      q = c + 1;
+    }
+  }
+  p[0] = term[0] ^ dir;
+  p[1] = term[1] ^ dir;
+  return p + 2;
+}
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, const trailing_string& x) {
+  copy_xor(p, reinterpret_cast<const byte_t*>(x.data()), x.size(), dir);
+  return p + x.size();
+}
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, const infinity& _) {
+  p[0] = inf[0] ^ dir;
+  p[1] = inf[1] ^ dir;
+  return p + 2;
+}
+
+template<byte_t dir = increasing>
+constexpr byte_t* put(byte_t* p, const string_or_infinity& x) {
+  if (x.inf) {
+    if (!x.s.empty()) {
+      throw runtime_error("orderedcode: string_or_infinity has non-zero string and non-zero infinity");
+    }
+    return put<dir>(p, infinity{});
+  }
+  return put<dir>(p, x.s);
+}
+
+template<byte_t dir = increasing, typename T>
+constexpr byte_t* put(byte_t* p, const decr<T>& d) {
+  return put<byte_t(dir ^ 0xff)>(p, d.val);
+}
+
+// Upper bound on the encoded size of a fixed-width type. Strings have no bound and no value.
+template<typename T>
+struct max_size {};
+
+template<>
+struct max_size<uint64_t> : std::integral_constant<size_t, 9> {};
+
+template<>
+struct max_size<int64_t> : std::integral_constant<size_t, 10> {};
+
+template<>
+struct max_size<float64_t> : std::integral_constant<size_t, 10> {};
+
+template<>
+struct max_size<infinity> : std::integral_constant<size_t, 2> {};
+
+template<typename T>
+struct max_size<decr<T>> : max_size<T> {};
+
+template<typename T>
+concept fixed_width = requires { max_size<T>::value; };
+
+// Like put, but never stores past e. The caller has checked that the encoding itself fits.
+template<byte_t dir = increasing, typename T>
+byte_t* put_within(byte_t* p, byte_t* e, const T& x) {
+  if constexpr (fixed_width<T>) {
+    if (size_t(e - p) < put_slack) {
+      byte_t buf[put_slack];
+      auto n = put<dir>(buf, x) - buf;
+      memcpy(p, buf, n);
+      return p + n;
     }
   }
-  s.insert(s.end(), l, x.end());
+  return put<dir>(p, x);
+}
+
+}// namespace detail
+
+inline void invert(span<byte_t>& s) {
+  detail::copy_xor(s.data(), s.data(), s.size(), decreasing);
+}
+
+// Compile-time upper bound on the encoded size of a tuple of fixed-width types.
+template<typename... Ts>
+constexpr size_t max_encoded_size = (detail::max_size<Ts>::value + ... + 0);
+
+constexpr size_t encoded_size(uint64_t x) {
+  return x == 0 ? 1 : 1 + (64 - std::countl_zero(x) + 7) / 8;
+}
+
+constexpr size_t encoded_size(int64_t x) {
+  if (x >= -64 && x < 64) {
+    return 1;
+  }
+  return (64 - std::countl_zero(uint64_t(x < 0 ? ~x : x)) + 7) / 7;
+}
+
+constexpr size_t encoded_size(float64_t x) {
+  return encoded_size(detail::float_bits(x));
+}
+
+constexpr size_t encoded_size(std::string_view x) {
+  size_t n = x.size() + 2;
+  if (std::is_constant_evaluated()) {
+    for (char c : x) {
+      n += c == '\x00' || c == '\xff';
+    }
+    return n;
+  }
+  auto p = reinterpret_cast<const byte_t*>(x.data());
+  auto e = p + x.size();
+  for (p = detail::find_special(p, e); p < e; p = detail::find_special(p + 1, e)) {
+    n++;
+  }
+  return n;
+}
+
+constexpr size_t encoded_size(const trailing_string& x) {
+  return x.size();
+}
+
+constexpr size_t encoded_size(const infinity& _) {
+  return 2;
+}
+
+constexpr size_t encoded_size(const string_or_infinity& x) {
+  return x.inf ? encoded_size(infinity{}) : encoded_size(x.s);
+}
+
+template<typename T>
+constexpr size_t encoded_size(const decr<T>& d) {
+  return encoded_size(d.val);
+}
+
+template<typename It, typename It2, typename... Its>
+constexpr size_t encoded_size(const It& it, const It2& it2, const Its&... its) {
+  return encoded_size(it) + encoded_size(it2, its...);
+}
+
+inline void append(bytes& s, uint64_t x) {
+  auto o = s.size();
+  s.resize(o + detail::put_slack);
+  s.resize(detail::put(&s[o], x) - s.data());
+}
+
+inline void append(bytes& s, int64_t x) {
+  auto o = s.size();
+  s.resize(o + detail::put_slack);
+  s.resize(detail::put(&s[o], x) - s.data());
+}
+
+inline void append(bytes& s, float64_t x) {
+  auto o = s.size();
+  s.resize(o + detail::put_slack);
+  s.resize(detail::put(&s[o], x) - s.data());
+}
+
+inline void append(bytes& s, const std::string& x) {
+  auto p = reinterpret_cast<const byte_t*>(x.data());
+  auto e = p + x.size();
+  for (;;) {
+    auto c = detail::find_special(p, e);
+    s.insert(s.end(), p, c);
+    if (c == e) {
+      break;
+    }
+    auto lit = *c == 0x00 ? lit00 : litff;
+    s.insert(s.end(), &lit[0], &lit[0] + 2);
+    p = c + 1;
+  }
   s.insert(s.end(), &term[0], &term[0] + 2);
 }
 
-void append(bytes& s, const trailing_string& x) {
+inline void append(bytes& s, const trailing_string& x) {
   s.insert(s.end(), x.begin(), x.end());
 }
 
-void append(bytes& s, const infinity& _) {
+inline void append(bytes& s, const infinity& _) {
   s.insert(s.end(), &inf[0], &inf[0] + 2);
 }
 
-void append(bytes& s, const string_or_infinity& x) {
+inline void append(bytes& s, const string_or_infinity& x) {
   if (x.inf) {
     if (!x.s.empty()) {
       throw runtime_error("orderedcode: string_or_infinity has non-zero string and non-zero infinity");
@@ -165,44 +550,283 @@ void append(bytes& s, const string_or_infinity& x) {
   }
 }
 
+// A sink is an output destination for the multi-field append. prepare(n) returns writable room for at
+// least n more bytes after its contents, and commit(p) keeps what was written up to p.
+template<typename S>
+concept sink = requires(S& s, size_t n, byte_t* p) {
+  { s.prepare(n) } -> std::same_as<span<byte_t>>;
+  s.commit(p);
+};
+
+// Sink over a resizable contiguous container of bytes or chars, such as bytes or std::string.
+template<typename C>
+struct container_sink {
+  C& c;
+
+  span<byte_t> prepare(size_t n) {
+    auto o = c.size();
+    c.resize(o + n + detail::put_slack);
+    return {reinterpret_cast<byte_t*>(c.data()) + o, n + detail::put_slack};
+  }
+
+  void commit(byte_t* p) {
+    c.resize(p - reinterpret_cast<byte_t*>(c.data()));
+  }
+};
+
+// Sink over a fixed caller-owned buffer, e.g. a raw pointer and capacity or a std::array.
+struct buffer_sink {
+  span<byte_t> buf;
+  size_t size = 0;
+
+  span<byte_t> prepare(size_t n) {
+    if (buf.size() - size < n) {
+      throw runtime_error("orderedcode: buffer too small");
+    }
+    return buf.subspan(size);
+  }
+
+  void commit(byte_t* p) {
+    size = p - buf.data();
+  }
+};
+
+// Bump allocator sink that packs many keys into large blocks. Bytes committed since the last take()
+// form the current key; they are moved along if a block runs out, so every key stays contiguous.
+class arena {
+public:
+  explicit arena(size_t block_size = 4096) : block_size_(block_size) {}
+
+  span<byte_t> prepare(size_t n) {
+    if (size_t(end_ - cur_) < n) {
+      refill(n);
+    }
+    return {cur_, end_};
+  }
+
+  void commit(byte_t* p) {
+    cur_ = p;
+  }
+
+  // Returns the current key and starts a new one. The bytes stay valid until reset or destruction.
+  span<byte_t> take() {
+    span<byte_t> k(start_, cur_);
+    start_ = cur_;
+    return k;
+  }
+
+  // Drops all keys. When more than one block was used, they are replaced by a single block of their
+  // combined size, so a workload that repeats per batch settles on one allocation per arena.
+  void reset() {
+    if (blocks_.size() > 1) {
+      blocks_.clear();
+      block_size_ = std::max(block_size_, capacity_);
+      capacity_ = 0;
+      start_ = cur_ = end_ = nullptr;
+      refill(0);
+    }
+    start_ = cur_ = blocks_.empty() ? nullptr : blocks_.back().get();
+  }
+
+private:
+  void refill(size_t n) {
+    size_t pending = cur_ - start_;
+    size_t size = std::max(block_size_, 2 * (pending + n));
+    auto block = std::make_unique<byte_t[]>(size);
+    if (pending > 0) {
+      memcpy(block.get(), start_, pending);
+    }
+    start_ = block.get();
+    cur_ = start_ + pending;
+    end_ = start_ + size;
+    capacity_ += size;
+    blocks_.push_back(std::move(block));
+  }
+
+  size_t block_size_;
+  size_t capacity_ = 0;
+  vector<unique_ptr<byte_t[]>> blocks_;
+  byte_t* start_ = nullptr;
+  byte_t* cur_ = nullptr;
+  byte_t* end_ = nullptr;
+};
+
+// Decode target that unescapes into a caller-owned arena instead of a string per value: val borrows
+// from the parsed input when the encoded string is increasing and has no escapes, and otherwise points
+// at bytes in *mem. Views into the arena stay valid until mem is reset, so a block of keys can be
+// decoded into one arena and released with a single reset. The arena must not have a pending key.
+struct arena_string {
+  arena* mem;
+  string_view val;
+};
+
+// Multi-field append sizes the whole tuple up front and asks the sink for room once.
+template<sink S, typename It, typename... Its>
+void append(S& s, const It& it, const Its&... its) {
+  auto r = s.prepare(encoded_size(it, its...));
+  byte_t* p = r.data();
+  byte_t* e = p + r.size();
+  try {
+    p = detail::put_within(p, e, it);
+    ((p = detail::put_within(p, e, its)), ...);
+  } catch (...) {
+    s.commit(r.data());
+    throw;
+  }
+  s.commit(p);
+}
+
+template<typename It, typename... Its>
+void append(bytes& s, const It& it, const Its&... its) {
+  container_sink<bytes> k{s};
+  append(k, it, its...);
+}
+
+template<typename It, typename... Its>
+void append(std::string& s, const It& it, const Its&... its) {
+  container_sink<std::string> k{s};
+  append(k, it, its...);
+}
+
 template<typename T>
 void append(bytes& s, decr<T> d) {
-  size_t n = s.size();
-  append(s, d.val);
-  span<byte_t> sp(&s[n], s.size() - n);
-  invert(sp);
+  container_sink<bytes> k{s};
+  append(k, d);
 }
 
+// Encodes the tuple into dst and returns the number of bytes written. Throws if dst is too small.
 template<typename It, typename... Its>
-void append(bytes& s, It it, Its... its) {
-  append(s, it);
-  append(s, its...);
+size_t encode(span<byte_t> dst, const It& it, const Its&... its) {
+  buffer_sink k{dst};
+  append(k, it, its...);
+  return k.size;
+}
+
+// Reusable key buffer for building many keys in a loop. The buffer is kept across keys and never shrinks,
+// and mark()/truncate() roll back to a shared prefix, so probing many keys that share leading fields
+// encodes the prefix once and allocates only until the buffer has grown to the longest key:
+//   key_builder kb;
+//   kb.append(table, user_id);
+//   auto m = kb.mark();
+//   for (auto& t : types) { kb.truncate(m); kb.append(t); lookup(kb.key()); }
+// key() views the current bytes and is invalidated by the next append.
+class key_builder {
+public:
+  key_builder() = default;
+
+  explicit key_builder(size_t capacity) : buf_(capacity) {}
+
+  span<byte_t> prepare(size_t n) {
+    if (buf_.size() - size_ < n) {
+      buf_.resize(std::max(size_ + n, 2 * buf_.size()));
+    }
+    return {buf_.data() + size_, buf_.data() + buf_.size()};
+  }
+
+  void commit(byte_t* p) {
+    size_ = p - buf_.data();
+  }
+
+  template<typename It, typename... Its>
+  key_builder& append(const It& it, const Its&... its) {
+    orderedcode::append(*this, it, its...);
+    return *this;
+  }
+
+  // Appends bytes that are already encoded, such as a constant_key prefix or another key.
+  key_builder& append_encoded(span<const byte_t> k) {
+    if (!k.empty()) {
+      auto r = prepare(k.size());
+      memcpy(r.data(), k.data(), k.size());
+      commit(r.data() + k.size());
+    }
+    return *this;
+  }
+
+  size_t mark() const {
+    return size_;
+  }
+
+  // Drops everything appended after m was taken.
+  void truncate(size_t m) {
+    if (m > size_) {
+      throw runtime_error("orderedcode: truncate past the end of the key");
+    }
+    size_ = m;
+  }
+
+  void clear() {
+    size_ = 0;
+  }
+
+  span<byte_t> key() {
+    return {buf_.data(), size_};
+  }
+
+  span<const byte_t> key() const {
+    return {buf_.data(), size_};
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+private:
+  bytes buf_;
+  size_t size_ = 0;
+};
+
+// Encodes constant fields at compile time, so fixed key prefixes are baked into the binary. f is a
+// captureless lambda returning the fields as a tuple, with strings as string_view or literals:
+//   constexpr auto users = constant_key([] { return std::tuple{"users", uint64_t(7)}; });
+// and the variable part of a key is appended after a copy of the result.
+template<typename F>
+consteval auto constant_key(F f) {
+  constexpr size_t n = std::apply([](const auto&... xs) { return (encoded_size(xs) + ... + 0); }, F{}());
+  std::array<byte_t, n + detail::put_slack> buf{};
+  byte_t* p = buf.data();
+  std::apply([&](const auto&... xs) { ((p = detail::put(p, xs)), ...); }, f());
+  std::array<byte_t, n> key{};
+  std::copy(buf.begin(), buf.begin() + n, key.begin());
+  return key;
 }
 
-void parse(span<byte_t>& s, byte_t dir, int64_t& dst) {
+// Result of the non-throwing try_parse functions. On failure the input span is left unchanged.
+enum class status : byte_t {
+  ok,
+  corrupt,
+  nan,
+};
+
+inline status try_parse(span<byte_t>& s, byte_t dir, int64_t& dst) noexcept {
   if (s.empty()) {
-    throw runtime_error("orderedcode: corrupt input");
+    return status::corrupt;
   }
   byte_t c = s[0] ^ dir;
   if (c >= 0x40 && c < 0xc0) {
     dst = int64_t(int8_t(c ^ 0x80));
     s = s.subspan(1);
-    return;
+    return status::ok;
   }
   bool neg = (c & 0x80) == 0;
   if (neg) {
     c = ~c;
     dir = ~dir;
   }
+  size_t o = 0;
   size_t n = 0;
   if (c == 0xff) {
     if (s.size() == 1) {
-      throw runtime_error("orderedcode: corrupt input");
+      return status::corrupt;
     }
-    s = s.subspan(1);
-    c = s[0] ^ dir;
+    o = 1;
+    c = s[1] ^ dir;
     if (c > 0xc0) {
-      throw runtime_error("orderedcode: corrupt input");
+      return status::corrupt;
     }
     n = 7;
   }
@@ -210,28 +834,29 @@ void parse(span<byte_t>& s, byte_t dir, int64_t& dst) {
     c &= ~mask;
     n++;
   }
-  if (s.size() < n) {
-    throw runtime_error("orderedcode: corrupt input");
+  if (s.size() - o < n) {
+    return status::corrupt;
   }
   int64_t x = c;
   for (size_t i = 1; i < n; i++) {
-    c = s[i] ^ dir;
+    c = s[o + i] ^ dir;
     x = x << 8 | c;
   }
   if (neg) {
     x = ~x;
   }
   dst = x;
-  s = s.subspan(n);
+  s = s.subspan(o + n);
+  return status::ok;
 }
 
-void parse(span<byte_t>& s, byte_t dir, uint64_t& dst) {
+inline status try_parse(span<byte_t>& s, byte_t dir, uint64_t& dst) noexcept {
   if (s.empty()) {
-    throw runtime_error("orderedcode: corrupt input");
+    return status::corrupt;
   }
   byte_t n = s[0] ^ dir;
   if (n > 8 || s.size() < 1 + n) {
-    throw runtime_error("orderedcode: corrupt input");
+    return status::corrupt;
   }
   uint64_t x = 0;
   for (size_t i = 0; i < n; i++) {
@@ -239,101 +864,190 @@ void parse(span<byte_t>& s, byte_t dir, uint64_t& dst) {
   }
   dst = x;
   s = s.subspan(1 + n);
+  return status::ok;
 }
 
-void parse(span<byte_t>& s, byte_t dir, infinity& _) {
+inline status try_parse(span<byte_t>& s, byte_t dir, infinity& _) noexcept {
   if (s.size() < 2) {
-    throw runtime_error("orderedcode: corrupt input");
+    return status::corrupt;
   }
   if ((s[0] ^ dir) != inf[0] || (s[1] ^ dir) != inf[1]) {
-    throw runtime_error("orderedcode: corrupt input");
+    return status::corrupt;
   }
   s = s.subspan(2);
+  return status::ok;
 }
 
-void parse(span<byte_t>& s, byte_t dir, string& dst) {
-  bytes buf;
-  for (auto l = 0, i = 0; i < s.size();) {
-    switch (s[i] ^ dir) {
-      case 0x00:
-        if (i + 1 >= s.size()) {
-          throw runtime_error("orderedcode: corrupt input");
-        }
-        switch (s[i + 1] ^ dir) {
-          case 0x01:
-            dst.clear();
-            if (l == 0 && dir == increasing) {
-              dst.insert(dst.end(), s.begin(), s.begin() + i);
-              s = s.subspan(i + 2);
-              return;
-            }
-            buf.insert(buf.end(), s.begin() + l, s.begin() + i);
-            if (dir == decreasing) {
-              span<byte_t> sp(buf);
-              invert(sp);
-            }
-            dst.insert(dst.end(), buf.begin(), buf.end());
-            s = s.subspan(i + 2);
-            return;
-          case 0xff:
-            buf.insert(buf.end(), s.begin() + l, s.begin() + i);
-            buf.insert(buf.end(), static_cast<byte_t>(0x00 ^ dir));
-            i += 2;
-            l = i;
-            break;
-          default:
-            throw runtime_error("orderedcode: corrupt input");
-        }
-        break;
-      case 0xff:
-        if (i + 1 >= s.size() || ((s[i + 1] ^ dir) != 0x00)) {
-          throw runtime_error("orderedcode: corrupt input");
-        }
-        buf.insert(buf.end(), s.begin() + l, s.begin() + i);
-        buf.insert(buf.end(), static_cast<byte_t>(0xff ^ dir));
-        i += 2;
-        l = i;
-        break;
-      default:
-        i++;
+// The string overloads only fail with an exception when growing dst throws.
+inline status try_parse(span<byte_t>& s, byte_t dir, string& dst) {
+  dst.clear();
+  const byte_t* p = s.data();
+  const byte_t* e = p + s.size();
+  for (;;) {
+    auto c = detail::find_special(p, e);
+    if (e - c < 2) {
+      return status::corrupt;
+    }
+    detail::append_xor(dst, p, c, dir);
+    byte_t c1 = c[1] ^ dir;
+    if ((*c ^ dir) == 0x00) {
+      if (c1 == 0x01) {
+        s = s.subspan(c + 2 - s.data());
+        return status::ok;
+      }
+      if (c1 != 0xff) {
+        return status::corrupt;
+      }
+      dst.push_back('\x00');
+    } else {
+      if (c1 != 0x00) {
+        return status::corrupt;
+      }
+      dst.push_back('\xff');
+    }
+    p = c + 2;
+  }
+}
+
+inline status try_parse(span<byte_t>& s, byte_t dir, string_ref& dst) {
+  if (dir == increasing) {
+    const byte_t* e = s.data() + s.size();
+    auto c = detail::find_special(s.data(), e);
+    if (e - c >= 2 && c[0] == term[0] && c[1] == term[1]) {
+      dst.val = string_view(reinterpret_cast<const char*>(s.data()), c - s.data());
+      dst.copied = false;
+      s = s.subspan(c + 2 - s.data());
+      return status::ok;
     }
   }
-  throw runtime_error("orderedcode: corrupt input");
+  auto st = try_parse(s, dir, dst.scratch);
+  dst.val = dst.scratch;
+  dst.copied = true;
+  return st;
 }
 
-void parse(span<byte_t>& s, byte_t dir, float64_t& dst) {
+inline status try_parse(span<byte_t>& s, byte_t dir, arena_string& dst) {
+  const byte_t* p = s.data();
+  const byte_t* e = p + s.size();
+  auto c = detail::find_special(p, e);
+  if (dir == increasing && e - c >= 2 && c[0] == term[0] && c[1] == term[1]) {
+    dst.val = string_view(reinterpret_cast<const char*>(p), c - p);
+    s = s.subspan(c + 2 - p);
+    return status::ok;
+  }
+  // find and check the terminator first, so the arena only has to make room for this field: unescaping
+  // never grows it.
+  const byte_t* end = c;
+  for (;;) {
+    if (e - end < 2) {
+      return status::corrupt;
+    }
+    byte_t c0 = *end ^ dir;
+    byte_t c1 = end[1] ^ dir;
+    if (c0 == 0x00 && c1 == 0x01) {
+      break;
+    }
+    if ((c0 == 0x00 && c1 != 0xff) || (c0 == 0xff && c1 != 0x00)) {
+      return status::corrupt;
+    }
+    end = detail::find_special(end + 2, e);
+  }
+  byte_t* q = dst.mem->prepare(end - p).data();
+  for (;;) {
+    detail::copy_xor(q, p, c - p, dir);
+    q += c - p;
+    if (c == end) {
+      break;
+    }
+    *q++ = *c ^ dir;
+    p = c + 2;
+    c = detail::find_special(p, end);
+  }
+  dst.mem->commit(q);
+  auto v = dst.mem->take();
+  dst.val = string_view(reinterpret_cast<const char*>(v.data()), v.size());
+  s = s.subspan(end + 2 - s.data());
+  return status::ok;
+}
+
+inline status try_parse(span<byte_t>& s, byte_t dir, float64_t& dst) noexcept {
+  auto t = s;
   int64_t i = 0;
-  parse(s, dir, i);
+  if (auto st = try_parse(t, dir, i); st != status::ok) {
+    return st;
+  }
   if (i < 0) {
     i = ((int64_t)-1 << 63) - i;
   }
-  memcpy(&dst, &i, sizeof(i));
-  if (isnan(dst)) {
-    throw runtime_error("parse: NaN");
+  float64_t f;
+  memcpy(&f, &i, sizeof(i));
+  if (isnan(f)) {
+    return status::nan;
   }
+  dst = f;
+  s = t;
+  return status::ok;
 }
 
-void parse(span<byte_t>& s, byte_t dir, string_or_infinity& dst) {
-  try {
-    infinity _;
-    parse(s, dir, _);
+inline status try_parse(span<byte_t>& s, byte_t dir, string_or_infinity& dst) {
+  // a string never starts with 0xff 0xff since a literal 0xff is escaped as 0xff 0x00.
+  if (s.size() >= 2 && (s[0] ^ dir) == inf[0] && (s[1] ^ dir) == inf[1]) {
+    dst.s.clear();
     dst.inf = true;
-    return;
-  } catch (...) {
-    parse(s, dir, dst.s);
+    s = s.subspan(2);
+    return status::ok;
   }
+  dst.inf = false;
+  return try_parse(s, dir, dst.s);
 }
 
-void parse(span<byte_t>& s, byte_t dir, trailing_string& dst) {
+inline status try_parse(span<byte_t>& s, byte_t dir, trailing_string& dst) {
   dst.clear();
-  if (dir == increasing) {
-    dst.insert(dst.end(), s.begin(), s.end());
-  } else {
-    invert(s);
-    dst.insert(dst.end(), s.begin(), s.end());
+  detail::append_xor(dst, s.data(), s.data() + s.size(), dir);
+  return status::ok;
+}
+
+template<typename T>
+status try_parse(span<byte_t>& s, decr<T>& dst) {
+  return try_parse(s, decreasing, dst.val);
+}
+
+template<typename It>
+status try_parse(span<byte_t>& s, It& it) {
+  return try_parse(s, increasing, it);
+}
+
+template<typename It, typename... Its>
+status try_parse(span<byte_t>& s, It& it, Its&... its) {
+  auto t = s;
+  status st = try_parse(t, it);
+  (void) (st == status::ok && (((st = try_parse(t, its)) == status::ok) && ...));
+  if (st == status::ok) {
+    s = t;
+  }
+  return st;
+}
+
+namespace detail {
+
+inline void check(status st) {
+  switch (st) {
+    case status::ok:
+      return;
+    case status::nan:
+      throw runtime_error("parse: NaN");
+    default:
+      throw runtime_error("orderedcode: corrupt input");
   }
 }
 
+}// namespace detail
+
+template<typename T>
+void parse(span<byte_t>& s, byte_t dir, T& dst) {
+  detail::check(try_parse(s, dir, dst));
+}
+
 template<typename T>
 void parse(span<byte_t>& s, decr<T>& dst) {
   parse(s, decreasing, dst.val);
@@ -0,0 +1,155 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <abbreviated_key.h>
+#include <keyrange.h>
+#include <orderedcode.h>
+#include <random>
+
+// Order-preserving range partitioning of encoded keys.
+//
+// choose_splitters picks parts - 1 splitter keys from a sample so that the parts get about the same
+// number of keys or key bytes, and key_router maps a key to its part. Part i holds the keys k with
+// splitters[i - 1] <= k < splitters[i], so every part is a contiguous key_range.
+namespace orderedcode {
+
+enum class weigh_by {
+  rows,
+  bytes,
+};
+
+// Uniform sample of a stream of keys of unknown length (reservoir sampling). Each kept key is copied.
+class key_sampler {
+public:
+  explicit key_sampler(size_t capacity, uint64_t seed = 0x9e3779b97f4a7c15) : capacity_(capacity), rng_(seed) {}
+
+  void add(span<const byte_t> k) {
+    if (sample_.size() < capacity_) {
+      sample_.emplace_back(k.begin(), k.end());
+    } else if (auto j = rng_() % (seen_ + 1); j < capacity_) {
+      sample_[j].assign(k.begin(), k.end());
+    }
+    seen_++;
+  }
+
+  span<const bytes> sample() const {
+    return sample_;
+  }
+
+  // Number of keys added so far.
+  size_t seen() const {
+    return seen_;
+  }
+
+private:
+  size_t capacity_;
+  std::mt19937_64 rng_;
+  vector<bytes> sample_;
+  size_t seen_ = 0;
+};
+
+namespace detail {
+
+// Returns the shortest key x with prev < x <= cur, given prev < cur.
+inline bytes shortest_separator(span<const byte_t> prev, span<const byte_t> cur) {
+  size_t n = std::mismatch(prev.begin(), prev.end(), cur.begin(), cur.end()).first - prev.begin();
+  return bytes(cur.begin(), cur.begin() + n + 1);
+}
+
+}// namespace detail
+
+// Chooses up to parts - 1 splitters from sample so the parts hold about equal shares of its rows or
+// bytes. A boundary that falls inside a run of equal keys moves to the end of the run, so a sample with
+// few distinct keys can yield fewer splitters. Each splitter is cut to the shortest key that separates
+// its part from the previous one, which keeps them small and routing cheap.
+inline vector<bytes> choose_splitters(span<const bytes> sample, size_t parts, weigh_by by = weigh_by::rows) {
+  if (parts == 0) {
+    throw runtime_error("orderedcode: zero partitions");
+  }
+  vector<span<const byte_t>> keys(sample.begin(), sample.end());
+  abbreviated_sort(keys.begin(), keys.end());
+  auto weight = [by](span<const byte_t> k) -> uint64_t { return by == weigh_by::rows ? 1 : k.size(); };
+  uint64_t total = 0;
+  for (auto k : keys) {
+    total += weight(k);
+  }
+  vector<bytes> out;
+  uint64_t before = 0;
+  size_t j = 1;
+  for (size_t i = 0; i < keys.size() && j < parts; i++) {
+    // key i opens part j once the weight before it reaches j / parts of the total.
+    if (i > 0 && before * parts >= total * j && compare_keys(keys[i - 1], keys[i]) < 0) {
+      out.push_back(detail::shortest_separator(keys[i - 1], keys[i]));
+      while (j < parts && before * parts >= total * j) {
+        j++;
+      }
+    }
+    before += weight(keys[i]);
+  }
+  return out;
+}
+
+// Maps keys to parts by splitter search. The search runs over the 8-byte key_prefix of each splitter and
+// compares whole keys only among the splitters whose prefix ties with the key's. Encoded keys often start
+// with low-entropy bytes such as integer length prefixes, where a table on the leading byte would not
+// narrow anything.
+class key_router {
+public:
+  // splitters must be non-empty keys in strictly increasing order.
+  explicit key_router(vector<bytes> splitters) : splitters_(std::move(splitters)) {
+    for (size_t i = 0; i < splitters_.size(); i++) {
+      if (splitters_[i].empty() || (i > 0 && compare_keys(splitters_[i - 1], splitters_[i]) >= 0)) {
+        throw runtime_error("orderedcode: splitters out of order");
+      }
+      prefixes_.push_back(key_prefix(splitters_[i]));
+    }
+  }
+
+  size_t route(span<const byte_t> k) const {
+    uint64_t h = key_prefix(k);
+    // branch-free count of the prefixes <= h: the comparisons are unpredictable for keys in random order.
+    size_t lo = 0;
+    size_t n = prefixes_.size();
+    while (n > 0) {
+      size_t half = n / 2;
+      bool le = prefixes_[lo + half] <= h;
+      lo = le ? lo + half + 1 : lo;
+      n = le ? n - half - 1 : half;
+    }
+    // the splitters counted with a prefix equal to h may still be greater than k.
+    while (lo > 0 && prefixes_[lo - 1] == h && compare_keys(k, splitters_[lo - 1]) < 0) {
+      lo--;
+    }
+    return lo;
+  }
+
+  size_t parts() const {
+    return splitters_.size() + 1;
+  }
+
+  const vector<bytes>& splitters() const {
+    return splitters_;
+  }
+
+  // Keys of part i.
+  key_range range(size_t i) const {
+    return {i == 0 ? bytes() : splitters_[i - 1], i == splitters_.size() ? bytes() : splitters_[i]};
+  }
+
+private:
+  vector<bytes> splitters_;
+  vector<uint64_t> prefixes_;
+};
+
+}// namespace orderedcode
@@ -0,0 +1,160 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <batch.h>
+#include <keyrange.h>
+#include <orderedcode.h>
+
+namespace orderedcode {
+
+namespace detail {
+
+// Buckets at or below this size are finished with a comparison sort.
+constexpr size_t radix_cutoff = 32;
+
+// Bucket of a key at depth d: 0 once the key has ended, otherwise its byte plus one.
+template<typename T>
+size_t radix_bucket(const T& k, size_t d) {
+  auto v = key_view(k);
+  return d < v.size() ? v[d] + 1 : 0;
+}
+
+// Sorts [first, last), whose keys all share their first d bytes, by comparing the rest.
+template<typename It>
+void radix_fallback(It first, It last, size_t d) {
+  std::sort(first, last, [d](const auto& a, const auto& b) {
+    auto va = key_view(a);
+    auto vb = key_view(b);
+    return compare_keys(va.subspan(std::min(d, va.size())), vb.subspan(std::min(d, vb.size()))) < 0;
+  });
+}
+
+// Distributes [first, last) in place into 257 buckets by the byte at depth d (American flag sort) and
+// returns the bucket boundaries. cache has room for one bucket number per key and is swapped along with
+// the keys so each key is looked at once per level.
+template<typename It>
+std::array<size_t, 258> radix_partition(It first, It last, size_t d, uint16_t* cache) {
+  size_t n = last - first;
+  std::array<size_t, 258> bounds{};
+  for (size_t i = 0; i < n; i++) {
+    cache[i] = static_cast<uint16_t>(radix_bucket(first[i], d));
+    bounds[cache[i] + 1]++;
+  }
+  for (size_t b = 1; b < bounds.size(); b++) {
+    bounds[b] += bounds[b - 1];
+  }
+  if (bounds[cache[0] + 1] - bounds[cache[0]] == n) {
+    return bounds;
+  }
+  std::array<size_t, 257> next;
+  std::copy(bounds.begin(), bounds.end() - 1, next.begin());
+  for (size_t b = 0; b < 257; b++) {
+    while (next[b] < bounds[b + 1]) {
+      auto v = cache[next[b]];
+      if (v == b) {
+        next[b]++;
+      } else {
+        auto j = next[v]++;
+        std::iter_swap(first + next[b], first + j);
+        std::swap(cache[next[b]], cache[j]);
+      }
+    }
+  }
+  return bounds;
+}
+
+template<typename It>
+void radix_sort_from(It first, It last, size_t d, uint16_t* cache) {
+  while (size_t(last - first) > radix_cutoff) {
+    auto bounds = radix_partition(first, last, d, cache);
+    // keys that ended at depth d are all equal. Recurse into all buckets but the largest, which is
+    // handled by the loop so the stack stays shallow on long shared prefixes.
+    size_t big = 1;
+    for (size_t b = 2; b < 257; b++) {
+      if (bounds[b + 1] - bounds[b] > bounds[big + 1] - bounds[big]) {
+        big = b;
+      }
+    }
+    for (size_t b = 1; b < 257; b++) {
+      if (b != big && bounds[b + 1] - bounds[b] > 1) {
+        radix_sort_from(first + bounds[b], first + bounds[b + 1], d + 1, cache + bounds[b]);
+      }
+    }
+    cache += bounds[big];
+    last = first + bounds[big + 1];
+    first = first + bounds[big];
+    d++;
+  }
+  radix_fallback(first, last, d);
+}
+
+}// namespace detail
+
+// Sorts encoded keys into byte order with an MSD radix sort. The elements may be bytes, spans of bytes
+// or std::string, and are moved by swapping.
+template<typename It>
+void radix_sort(It first, It last) {
+  vector<uint16_t> cache(last - first);
+  detail::radix_sort_from(first, last, 0, cache.data());
+}
+
+namespace detail {
+
+template<typename It>
+void radix_sort_on(thread_pool* pool, It first, It last, size_t threads) {
+  size_t n = last - first;
+  threads = batch_threads(threads, n);
+  if (threads == 1) {
+    radix_sort(first, last);
+    return;
+  }
+  vector<uint16_t> cache(n);
+  auto bounds = radix_partition(first, last, 0, cache.data());
+  vector<size_t> order;
+  for (size_t b = 1; b < 257; b++) {
+    if (bounds[b + 1] - bounds[b] > 1) {
+      order.push_back(b);
+    }
+  }
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return bounds[a + 1] - bounds[a] > bounds[b + 1] - bounds[b]; });
+  std::atomic<size_t> next{0};
+  parallel_for(pool, threads, threads, [&](size_t, size_t) {
+    for (size_t i; (i = next++) < order.size();) {
+      auto b = order[i];
+      radix_sort_from(first + bounds[b], first + bounds[b + 1], 1, cache.data() + bounds[b]);
+    }
+  });
+}
+
+}// namespace detail
+
+// Like radix_sort, with the buckets after the first byte sorted on up to threads threads, 0 meaning one
+// per core, started for this call. Buckets are handed out largest first so a skewed leading byte does not
+// leave threads idle.
+template<typename It>
+void radix_sort(It first, It last, size_t threads) {
+  detail::radix_sort_on(nullptr, first, last, threads);
+}
+
+// Like radix_sort with threads, running on the threads of pool.
+template<typename It>
+void radix_sort(It first, It last, thread_pool& pool) {
+  detail::radix_sort_on(&pool, first, last, pool.size());
+}
+
+}// namespace orderedcode
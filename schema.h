@@ -0,0 +1,114 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <array>
+#include <orderedcode.h>
+#include <tuple>
+#include <utility>
+
+namespace orderedcode {
+
+namespace detail {
+
+// Value type and direction of a schema field: decr<T> is a T stored decreasing.
+template<typename T>
+struct field_traits {
+  using type = T;
+  static constexpr byte_t dir = increasing;
+};
+
+template<typename T>
+struct field_traits<decr<T>> {
+  using type = typename field_traits<T>::type;
+  static constexpr byte_t dir = field_traits<T>::dir ^ 0xff;
+};
+
+}// namespace detail
+
+// Key layout fixed at compile time, e.g. schema<uint64_t, decr<std::string>, int64_t>. Fields are
+// passed and returned as plain values; their directions come from the schema, so writers and readers
+// sharing one schema cannot disagree on field order or direction. Encoding and decoding are unrolled
+// over the fields with the direction of each one as a constant.
+template<typename... Ts>
+struct schema {
+  using value_type = std::tuple<typename detail::field_traits<Ts>::type...>;
+
+  static constexpr size_t size = sizeof...(Ts);
+  static constexpr std::array<byte_t, sizeof...(Ts)> directions = {detail::field_traits<Ts>::dir...};
+  static constexpr bool fixed_width = (detail::fixed_width<Ts> && ...);
+
+  // Largest encoded key for a schema of fixed-width fields, for sizing stack buffers.
+  static constexpr size_t max_size() requires fixed_width {
+    return max_encoded_size<Ts...>;
+  }
+
+  static size_t encoded_size(const typename detail::field_traits<Ts>::type&... vals) {
+    return (orderedcode::encoded_size(vals) + ... + 0);
+  }
+
+  template<sink S>
+  static void append(S& s, const typename detail::field_traits<Ts>::type&... vals) {
+    auto r = s.prepare(encoded_size(vals...));
+    byte_t* p = r.data();
+    byte_t* e = p + r.size();
+    try {
+      ((p = detail::put_within<detail::field_traits<Ts>::dir>(p, e, vals)), ...);
+    } catch (...) {
+      s.commit(r.data());
+      throw;
+    }
+    s.commit(p);
+  }
+
+  static void append(bytes& s, const typename detail::field_traits<Ts>::type&... vals) {
+    container_sink<bytes> k{s};
+    append(k, vals...);
+  }
+
+  static void append(std::string& s, const typename detail::field_traits<Ts>::type&... vals) {
+    container_sink<std::string> k{s};
+    append(k, vals...);
+  }
+
+  static size_t encode(span<byte_t> dst, const typename detail::field_traits<Ts>::type&... vals) {
+    buffer_sink k{dst};
+    append(k, vals...);
+    return k.size;
+  }
+
+  static status try_decode(span<byte_t>& s, value_type& dst) {
+    return try_decode(s, dst, std::index_sequence_for<Ts...>{});
+  }
+
+  // Decodes one key, e.g. auto [id, name, ts] = schema<...>::decode(s).
+  static value_type decode(span<byte_t>& s) {
+    value_type dst;
+    detail::check(try_decode(s, dst));
+    return dst;
+  }
+
+private:
+  template<size_t... Is>
+  static status try_decode(span<byte_t>& s, value_type& dst, std::index_sequence<Is...>) {
+    auto t = s;
+    status st = status::ok;
+    ((st = try_parse(t, directions[Is], std::get<Is>(dst)), st == status::ok) && ...);
+    if (st == status::ok) {
+      s = t;
+    }
+    return st;
+  }
+};
+
+}// namespace orderedcode
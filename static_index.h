@@ -0,0 +1,214 @@
+// Copyright 2022 Jungyong Um
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <abbreviated_key.h>
+#include <keyrange.h>
+#include <orderedcode.h>
+
+// Read-only search index over sorted encoded keys.
+//
+// The keys are stored back to back in one blob. Their 8-byte key_prefix values, taken after the prefix
+// all keys share, are laid out as an implicit B-tree of 64-byte nodes holding 8 prefixes each, where the
+// children of node k are nodes k * 9 + 1 to k * 9 + 9 and the prefixes fill the tree in order. A lookup
+// touches one cache line per level, about log9(n), ranks the probe within each node with a vector
+// compare, and compares whole keys only among the keys whose prefix ties with the probe's.
+namespace orderedcode {
+
+namespace detail {
+
+constexpr size_t index_node_keys = 8;
+
+struct alignas(64) index_node {
+  uint64_t keys[index_node_keys];
+};
+
+inline size_t index_child(size_t k, size_t i) {
+  return k * (index_node_keys + 1) + i + 1;
+}
+
+// Returns the position of the first prefix >= x in sorted order, or n if there is none.
+using index_search_fn = size_t (*)(const index_node*, const uint32_t*, size_t, size_t, uint64_t);
+
+inline size_t index_search_scalar(const index_node* tree, const uint32_t* pos, size_t nodes, size_t n, uint64_t x) {
+  size_t res = n;
+  for (size_t k = 0; k < nodes;) {
+    size_t i = 0;
+    for (size_t j = 0; j < index_node_keys; j++) {
+      i += tree[k].keys[j] < x;
+    }
+    if (i < index_node_keys) {
+      res = pos[k * index_node_keys + i];
+    }
+    k = index_child(k, i);
+  }
+  return res;
+}
+
+#ifdef ORDEREDCODE_X86
+ORDEREDCODE_TARGET_AVX2 inline size_t index_search_avx2(const index_node* tree, const uint32_t* pos, size_t nodes,
+                                                        size_t n, uint64_t x) {
+  // AVX2 only compares signed 64-bit integers, so both sides have their top bit flipped.
+  const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i xv = _mm256_xor_si256(_mm256_set1_epi64x(int64_t(x)), flip);
+  size_t res = n;
+  for (size_t k = 0; k < nodes;) {
+    auto keys = reinterpret_cast<const __m256i*>(tree[k].keys);
+    __m256i a = _mm256_cmpgt_epi64(xv, _mm256_xor_si256(_mm256_load_si256(keys), flip));
+    __m256i b = _mm256_cmpgt_epi64(xv, _mm256_xor_si256(_mm256_load_si256(keys + 1), flip));
+    auto m = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(a))) |
+             unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(b))) << 4;
+    size_t i = std::popcount(m);
+    if (i < index_node_keys) {
+      res = pos[k * index_node_keys + i];
+    }
+    k = index_child(k, i);
+  }
+  return res;
+}
+#endif
+
+inline index_search_fn select_index_search() {
+#ifdef ORDEREDCODE_X86
+  return has_avx2() ? index_search_avx2 : index_search_scalar;
+#else
+  return index_search_scalar;
+#endif
+}
+
+}// namespace detail
+
+class static_index {
+public:
+  static_index() = default;
+
+  // Builds the index from keys in non-decreasing order, which may be bytes, spans of bytes or std::string.
+  template<typename It>
+  static_index(It first, It last) {
+    size_t n = last - first;
+    if (n >= UINT32_MAX) {
+      throw runtime_error("orderedcode: too many keys for a static_index");
+    }
+    offsets_.reserve(n + 1);
+    offsets_.push_back(0);
+    for (auto it = first; it != last; ++it) {
+      auto k = detail::key_view(*it);
+      if (offsets_.size() > 1 && compare_keys(key(offsets_.size() - 2), k) > 0) {
+        throw runtime_error("orderedcode: keys added out of order");
+      }
+      blob_.insert(blob_.end(), k.begin(), k.end());
+      offsets_.push_back(blob_.size());
+    }
+    if (n > 0) {
+      // sorted keys share the common prefix of the first and the last.
+      auto a = key(0);
+      auto z = key(n - 1);
+      shared_ = std::mismatch(a.begin(), a.end(), z.begin(), z.end()).first - a.begin();
+    }
+    prefixes_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      prefixes_[i] = key_prefix(key(i).subspan(shared_));
+    }
+    tree_.resize((n + detail::index_node_keys - 1) / detail::index_node_keys);
+    pos_.resize(tree_.size() * detail::index_node_keys);
+    size_t t = 0;
+    build(0, t);
+  }
+
+  size_t size() const {
+    return prefixes_.size();
+  }
+
+  bool empty() const {
+    return prefixes_.empty();
+  }
+
+  span<const byte_t> key(size_t i) const {
+    return span<const byte_t>(blob_).subspan(offsets_[i], offsets_[i + 1] - offsets_[i]);
+  }
+
+  span<const byte_t> operator[](size_t i) const {
+    return key(i);
+  }
+
+  // Position of the first key not less than k, or size() if there is none.
+  size_t lower_bound(span<const byte_t> k) const {
+    size_t n = size();
+    if (n == 0) {
+      return 0;
+    }
+    auto common = key(0).first(shared_);
+    size_t m = std::mismatch(common.begin(), common.end(), k.begin(), k.end()).first - common.begin();
+    if (m < shared_) {
+      // k is a proper prefix of every key, or differs from them in the shared part.
+      return m == k.size() || k[m] < common[m] ? 0 : n;
+    }
+    auto rest = k.subspan(shared_);
+    uint64_t p = key_prefix(rest);
+    static const detail::index_search_fn search = detail::select_index_search();
+    size_t i = search(tree_.data(), pos_.data(), tree_.size(), n, p);
+    if (i == n || prefixes_[i] != p) {
+      return i;
+    }
+    // keys whose prefix ties with k's are ordered by their remaining bytes.
+    size_t j = p == UINT64_MAX ? n : search(tree_.data(), pos_.data(), tree_.size(), n, p + 1);
+    while (i < j) {
+      size_t mid = i + (j - i) / 2;
+      if (compare_keys(key(mid).subspan(shared_), rest) < 0) {
+        i = mid + 1;
+      } else {
+        j = mid;
+      }
+    }
+    return i;
+  }
+
+  // Position of a key equal to k, or size() if there is none.
+  size_t find(span<const byte_t> k) const {
+    size_t i = lower_bound(k);
+    return i < size() && compare_keys(key(i), k) == 0 ? i : size();
+  }
+
+  // Positions [first, second) of the keys in r, for iterating with key(i).
+  std::pair<size_t, size_t> range(const key_range& r) const {
+    size_t lo = lower_bound(r.lo);
+    size_t hi = r.hi.empty() ? size() : std::max(lo, lower_bound(r.hi));
+    return {lo, hi};
+  }
+
+private:
+  // Fills the subtree at node k in order with the prefixes from t on, padding past the end with keys
+  // that no probe ranks below.
+  void build(size_t k, size_t& t) {
+    if (k >= tree_.size()) {
+      return;
+    }
+    for (size_t i = 0; i < detail::index_node_keys; i++) {
+      build(detail::index_child(k, i), t);
+      bool real = t < prefixes_.size();
+      tree_[k].keys[i] = real ? prefixes_[t] : UINT64_MAX;
+      pos_[k * detail::index_node_keys + i] = static_cast<uint32_t>(real ? t : prefixes_.size());
+      t++;
+    }
+    build(detail::index_child(k, detail::index_node_keys), t);
+  }
+
+  bytes blob_;
+  vector<size_t> offsets_;
+  size_t shared_ = 0;
+  vector<uint64_t> prefixes_;
+  vector<detail::index_node> tree_;
+  vector<uint32_t> pos_;
+};
+
+}// namespace orderedcode
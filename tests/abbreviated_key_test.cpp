@@ -0,0 +1,83 @@
+#include <abbreviated_key.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <random>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("abbreviated key: prefixes", "[noir][abbrev]") {
+  CHECK(key_prefix(bytes{}) == 0);
+  CHECK(key_prefix(bytes{0x01, 0x02}) == 0x0102000000000000);
+  CHECK(key_prefix(bytes{1, 2, 3, 4, 5, 6, 7, 8, 9}) == 0x0102030405060708);
+  CHECK(key_prefix<16>(bytes{1, 2, 3, 4, 5, 6, 7, 8, 9}) == prefix128{0x0102030405060708, 0x0900000000000000});
+
+  // prefixes never disagree with the key order.
+  mt19937_64 rng(3);
+  for (int i = 0; i < 10000; i++) {
+    bytes a(rng() % 20), b(rng() % 20);
+    for (auto& c : a) {
+      c = byte_t(rng() % 3);
+    }
+    for (auto& c : b) {
+      c = byte_t(rng() % 3);
+    }
+    int c = compare_keys(a, b);
+    if (key_prefix(a) != key_prefix(b)) {
+      CHECK((key_prefix(a) < key_prefix(b)) == (c < 0));
+    }
+    if (key_prefix<16>(a) != key_prefix<16>(b)) {
+      CHECK((key_prefix<16>(a) < key_prefix<16>(b)) == (c < 0));
+    }
+    CHECK(abbreviated_less{}(abbreviated_key<8>(a), abbreviated_key<8>(b)) == (c < 0));
+    CHECK(abbreviated_less{}(abbreviated_key<16>(a), abbreviated_key<16>(b)) == (c < 0));
+  }
+}
+
+TEST_CASE("abbreviated key: sort", "[noir][abbrev]") {
+  mt19937_64 rng(5);
+  vector<bytes> keys;
+  for (size_t i = 0; i < 50000; i++) {
+    bytes k;
+    orderedcode::append(k, uint64_t(rng() % 4), "table" + to_string(rng() % 1000), decr<int64_t>{int64_t(rng() % 100)});
+    keys.push_back(k);
+  }
+  auto want = keys;
+  std::sort(want.begin(), want.end(), key_less{});
+
+  auto got = keys;
+  abbreviated_sort(got.begin(), got.end());
+  CHECK(got == want);
+
+  got = keys;
+  abbreviated_sort<16>(got.begin(), got.end());
+  CHECK(got == want);
+
+  vector<span<const byte_t>> views(keys.begin(), keys.end());
+  abbreviated_sort(views.begin(), views.end());
+  for (size_t i = 0; i < views.size(); i++) {
+    CHECK(bytes(views[i].begin(), views[i].end()) == want[i]);
+  }
+
+  // long shared prefixes, zero bytes and keys that end inside a prefix take the tie-breaking paths.
+  vector<bytes> tied;
+  for (size_t i = 0; i < 20000; i++) {
+    bytes k(10, 0x07);
+    k.resize(10 + rng() % 30);
+    for (size_t j = 10; j < k.size(); j++) {
+      k[j] = byte_t(rng() % 2);
+    }
+    tied.push_back(k);
+  }
+  auto tied_want = tied;
+  std::sort(tied_want.begin(), tied_want.end(), key_less{});
+  got = tied;
+  abbreviated_sort(got.begin(), got.end());
+  CHECK(got == tied_want);
+  got = tied;
+  abbreviated_sort<16>(got.begin(), got.end());
+  CHECK(got == tied_want);
+
+  vector<std::string> strs = {"b", string("a\0", 2), "a", ""};
+  abbreviated_sort(strs.begin(), strs.end());
+  CHECK(strs == vector<std::string>{"", "a", string("a\0", 2), "b"});
+}
@@ -0,0 +1,152 @@
+#include <batch.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("batch: encode", "[noir][batch]") {
+  size_t n = 20000;
+  vector<uint64_t> ids(n);
+  vector<string> names(n);
+  vector<int64_t> ts(n);
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = i * 2654435761u;
+    names[i] = "name" + to_string(i % 97);
+    if (i % 5 == 0) {
+      names[i] += str_const("\x00\xff");
+    }
+    ts[i] = int64_t(i * 7919) - 50000;
+  }
+
+  column<uint64_t> c1{ids};
+  column<string> c2{names};
+  column<int64_t> c3{ts, decreasing};
+
+  key_batch kb;
+  encode_batch(kb, c1, c2, c3);
+  REQUIRE(kb.size() == n);
+  for (size_t i = 0; i < n; i++) {
+    bytes b;
+    orderedcode::append(b, ids[i], names[i], decr<int64_t>{ts[i]});
+    auto k = kb[i];
+    REQUIRE(bytes(k.begin(), k.end()) == b);
+  }
+
+  for (size_t threads : {0, 2, 3, 8}) {
+    key_batch pkb;
+    encode_batch(pkb, threads, c1, c2, c3);
+    CHECK(pkb.offsets == kb.offsets);
+    CHECK(pkb.data == kb.data);
+  }
+
+  thread_pool pool(4);
+  for (int round = 0; round < 3; round++) {
+    key_batch pkb;
+    encode_batch(pkb, pool, c1, c2, c3);
+    CHECK(pkb.offsets == kb.offsets);
+    CHECK(pkb.data == kb.data);
+  }
+
+  key_batch empty;
+  encode_batch(empty, 4, column<uint64_t>{}, column<string>{});
+  CHECK(empty.size() == 0);
+  CHECK(empty.data.empty());
+
+  vector<uint64_t> shorter(n - 1);
+  CHECK_THROWS(encode_batch(kb, c1, column<uint64_t>{shorter}));
+
+  vector<float64_t> fs(n, 1.0);
+  fs[n - 3] = std::nan("");
+  CHECK_THROWS(encode_batch(kb, 4, column<float64_t>{fs}));
+  CHECK_THROWS(encode_batch(kb, pool, column<float64_t>{fs}));
+  key_batch after, want;
+  encode_batch(after, pool, c1, c2, c3);
+  encode_batch(want, c1, c2, c3);
+  CHECK(after.data == want.data);
+}
+
+TEST_CASE("batch: decode", "[noir][batch]") {
+  size_t n = 20000;
+  vector<uint64_t> ids(n);
+  vector<string> names(n);
+  vector<int64_t> ts(n);
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = i * 2654435761u;
+    names[i] = "name" + to_string(i % 97);
+    if (i % 5 == 0) {
+      names[i] += str_const("\x00\xff");
+    }
+    ts[i] = int64_t(i * 7919) - 50000;
+  }
+  key_batch kb;
+  encode_batch(kb, column<uint64_t>{ids}, column<string>{names, decreasing}, column<int64_t>{ts, decreasing});
+
+  for (size_t threads : {1, 0, 3}) {
+    vector<uint64_t> dids;
+    vector<string> dnames;
+    vector<int64_t> dts;
+    decode_batch(kb, threads, column_out<uint64_t>{&dids}, column_out<string>{&dnames, decreasing},
+                 column_out<int64_t>{&dts, decreasing});
+    CHECK(dids == ids);
+    CHECK(dnames == names);
+    CHECK(dts == ts);
+  }
+
+  thread_pool pool(3);
+  vector<uint64_t> pids;
+  decode_batch(kb, pool, column_out<uint64_t>{&pids});
+  CHECK(pids == ids);
+
+  vector<int64_t> only;
+  decode_batch(kb, 4, column_out<uint64_t>{nullptr}, column_out<string>{nullptr, decreasing},
+               column_out<int64_t>{&only, decreasing});
+  CHECK(only == ts);
+
+  vector<uint64_t> first;
+  decode_batch(kb.data, kb.offsets, column_out<uint64_t>{&first}, column_out<string>{nullptr},
+               column_out<int64_t>{nullptr});
+  CHECK(first == ids);
+
+  kb.data[kb.offsets[n / 2]] ^= 0xff;
+  vector<uint64_t> broken;
+  CHECK_THROWS(decode_batch(kb, 4, column_out<uint64_t>{&broken}, column_out<string>{nullptr, decreasing}));
+
+  bytes six(6, 0x01);
+  vector<uint64_t> out;
+  for (vector<size_t> offsets : {vector<size_t>{0, 2, 100}, vector<size_t>{0, 4, 2, 6}, vector<size_t>{7}}) {
+    CHECK_THROWS_WITH(decode_batch(six, offsets, column_out<uint64_t>{&out}), "orderedcode: corrupt input");
+  }
+}
+
+TEST_CASE("batch: decode strings into an arena", "[noir][batch]") {
+  size_t n = 5000;
+  vector<string> keys(n), names(n);
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = "k" + to_string(i);
+    names[i] = "name" + to_string(i % 31);
+    if (i % 3 == 0) {
+      names[i] += str_const("\x00\xff");
+    }
+  }
+  key_batch kb;
+  encode_batch(kb, column<string>{keys}, column<string>{names, decreasing});
+
+  arena mem(256);
+  for (int round = 0; round < 3; round++) {
+    vector<string_view> dkeys, dnames;
+    decode_batch(kb, 0, column_out<string_view>{&dkeys, increasing, &mem},
+                 column_out<string_view>{&dnames, decreasing, &mem});
+    REQUIRE(dkeys.size() == n);
+    for (size_t i = 0; i < n; i++) {
+      CHECK(dkeys[i] == keys[i]);
+      CHECK(dnames[i] == names[i]);
+    }
+    // increasing strings without escapes borrow from the batch.
+    CHECK(reinterpret_cast<const byte_t*>(dkeys[1].data()) == kb.data.data() + kb.offsets[1]);
+    mem.reset();
+  }
+
+  vector<string_view> views;
+  CHECK_THROWS(decode_batch(kb, column_out<string_view>{&views}));
+}
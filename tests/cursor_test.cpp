@@ -0,0 +1,66 @@
+#include <cursor.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("cursor: skip", "[noir][cursor]") {
+  vector<int64_t> ints = {0, 63, -64, 64, -65, 8191, -8193, 1 << 20, -(1 << 27), ((int64_t)1 << 55), ((int64_t)1 << 62),
+                          numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max()};
+  string x = str_const("a\x00b\xff\xff");
+  string_or_infinity si{"", true};
+  for (auto i : ints) {
+    bytes b;
+    orderedcode::append(b, i, decr<int64_t>{i}, uint64_t(i), decr<uint64_t>{uint64_t(i)}, float64_t(i),
+                        decr<float64_t>{float64_t(i)}, x, decr<string>{x}, infinity{}, decr<infinity>{}, si,
+                        decr<string_or_infinity>{si}, string_or_infinity{x, false}, trailing_string{x});
+
+    span<byte_t> s(b);
+    skip<int64_t>(s);
+    skip<decr<int64_t>>(s);
+    skip<uint64_t>(s);
+    skip<decr<uint64_t>>(s);
+    skip<float64_t>(s);
+    skip<decr<float64_t>>(s);
+    skip<string>(s);
+    skip<decr<string>>(s);
+    skip<infinity>(s);
+    skip<decr<infinity>>(s);
+    skip<string_or_infinity>(s);
+    skip<decr<string_or_infinity>>(s);
+    skip<string_or_infinity>(s);
+    CHECK(bytes(s.begin(), s.end()) == bytes(x.begin(), x.end()));
+    skip<trailing_string>(s);
+    CHECK(s.empty());
+  }
+
+  bytes b = {'f', 'o', 'o', 0x00};
+  span<byte_t> s(b);
+  CHECK(try_skip<string>(s) == status::corrupt);
+  CHECK(s.size() == 4);
+  bytes b2 = {0x03, 0x01};
+  span<byte_t> s2(b2);
+  CHECK_THROWS(skip<uint64_t>(s2));
+}
+
+TEST_CASE("cursor: get", "[noir][cursor]") {
+  bytes b;
+  orderedcode::append(b, string("users"), uint64_t(7), decr<int64_t>{1700000000}, string(str_const("a\x00")),
+                      uint64_t(42));
+
+  cursor<string, uint64_t, decr<int64_t>, string_ref, uint64_t> c(b);
+  CHECK(c.get<4>() == 42);
+  CHECK(c.get<2>().val == 1700000000);
+  CHECK(c.get<0>() == "users");
+
+  string_ref r;
+  c.get<3>(r);
+  CHECK(r.val == string(str_const("a\x00")));
+  CHECK(c.field<1>().size() == 2);
+
+  bytes b2 = {'x', 0x00, 0x01, 0x09};
+  cursor<string, uint64_t> c2(b2);
+  CHECK(c2.get<0>() == "x");
+  CHECK_THROWS(c2.get<1>());
+}
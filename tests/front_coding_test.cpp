@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <front_coding.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <random>
+
+using namespace std;
+using namespace orderedcode;
+
+static vector<bytes> sorted_keys(size_t n) {
+  mt19937_64 rng(3);
+  vector<bytes> keys;
+  for (size_t i = 0; i < n; i++) {
+    bytes k;
+    orderedcode::append(k, uint64_t(rng() % 4), "index" + to_string(rng() % 20), decr<int64_t>{int64_t(rng() % 1000)});
+    keys.push_back(k);
+  }
+  sort(keys.begin(), keys.end());
+  return keys;
+}
+
+TEST_CASE("front coding: round trip", "[noir][front_coding]") {
+  for (size_t interval : {1, 4, 16}) {
+    for (size_t n : {0, 1, 5, 1000}) {
+      auto keys = sorted_keys(n);
+      block_builder bb(interval);
+      for (auto& k : keys) {
+        bb.add(k);
+      }
+      CHECK(bb.empty() == keys.empty());
+      auto expected = bb.size();
+      auto block = bb.finish();
+      CHECK(block.size() == expected);
+      CHECK(bb.empty());
+
+      block_iterator it(block);
+      for (auto& k : keys) {
+        REQUIRE(it.valid());
+        CHECK(bytes(it.key().begin(), it.key().end()) == k);
+        it.next();
+      }
+      CHECK(!it.valid());
+
+      size_t raw = 0;
+      for (auto& k : keys) {
+        raw += k.size();
+      }
+      if (n == 1000 && interval == 16) {
+        CHECK(block.size() * 2 < raw);
+      }
+    }
+  }
+}
+
+TEST_CASE("front coding: seek", "[noir][front_coding]") {
+  auto keys = sorted_keys(500);
+  block_builder bb;
+  for (auto& k : keys) {
+    bb.add(k);
+  }
+  auto block = bb.finish();
+  block_iterator it(block);
+
+  mt19937_64 rng(5);
+  for (int i = 0; i < 300; i++) {
+    bytes target;
+    orderedcode::append(target, uint64_t(rng() % 5), "index" + to_string(rng() % 20));
+    if (i % 3 == 0) {
+      target = keys[rng() % keys.size()];
+    }
+    it.seek(target);
+    auto want = lower_bound(keys.begin(), keys.end(), target);
+    if (want == keys.end()) {
+      CHECK(!it.valid());
+    } else {
+      REQUIRE(it.valid());
+      CHECK(bytes(it.key().begin(), it.key().end()) == *want);
+    }
+  }
+
+  it.seek(bytes{});
+  CHECK(bytes(it.key().begin(), it.key().end()) == keys.front());
+  it.seek(bytes{0xff, 0xff});
+  CHECK(!it.valid());
+}
+
+TEST_CASE("front coding: errors", "[noir][front_coding]") {
+  block_builder bb;
+  bb.add(bytes{0x02});
+  CHECK_THROWS(bb.add(bytes{0x01}));
+  CHECK_THROWS(block_builder(0));
+
+  bytes bad = {0x05, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00};
+  CHECK_THROWS(block_iterator(bad));
+  CHECK_THROWS(block_iterator(bytes{0x01}));
+}
@@ -0,0 +1,90 @@
+#include <key_compare.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <random>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+template<typename... Ts>
+static int encoded_compare(span<const byte_t> key, const Ts&... probe) {
+  bytes p;
+  orderedcode::append(p, probe...);
+  return compare_keys(key, p);
+}
+
+TEST_CASE("key compare: matches encoded comparison", "[noir][compare]") {
+  mt19937_64 rng(17);
+  auto str = [&] {
+    string s(rng() % 6, 'a');
+    for (auto& c : s) {
+      c = "a\x00\xff"[rng() % 3];
+    }
+    return s;
+  };
+  auto num = [&] { return int64_t(rng() % 7) - 3 + (rng() % 4 == 0 ? int64_t(rng()) : 0); };
+
+  for (int i = 0; i < 20000; i++) {
+    bytes key;
+    orderedcode::append(key, str(), uint64_t(rng() % 3), decr<string>{str()}, decr<int64_t>{num()});
+    if (rng() % 3 == 0) {
+      key.resize(rng() % (key.size() + 1));
+    }
+    string s1 = str(), s2 = str();
+    uint64_t u = rng() % 3;
+    int64_t n = num();
+    if (rng() % 2 == 0) {
+      // reuse leading fields of the key so the walk gets past them.
+      span<byte_t> sp(key);
+      try_parse(sp, s1, u);
+    }
+    CHECK(compare(key, s1) == encoded_compare(key, s1));
+    CHECK(compare(key, s1, u) == encoded_compare(key, s1, u));
+    CHECK(compare(key, s1, u, decr<string>{s2}) == encoded_compare(key, s1, u, decr<string>{s2}));
+    CHECK(compare(key, s1, u, decr<string>{s2}, decr<int64_t>{n}) ==
+          encoded_compare(key, s1, u, decr<string>{s2}, decr<int64_t>{n}));
+
+    bytes p;
+    orderedcode::append(p, s1, u);
+    bool starts = key.size() >= p.size() && equal(p.begin(), p.end(), key.begin());
+    int c = compare_prefix(key, s1, u);
+    CHECK((c == 0) == starts);
+    if (!starts) {
+      CHECK(c == encoded_compare(key, s1, u));
+    }
+  }
+}
+
+TEST_CASE("key compare: other field types", "[noir][compare]") {
+  bytes key;
+  orderedcode::append(key, string_or_infinity{"m", false}, float64_t(2.5), decr<float64_t>{-1.0}, infinity{});
+
+  CHECK(compare(key, string_or_infinity{"m", false}, float64_t(2.5), decr<float64_t>{-1.0}, infinity{}) == 0);
+  CHECK(compare(key, string_or_infinity{"", true}) == -1);
+  CHECK(compare(key, string_or_infinity{"l", false}) == 1);
+  CHECK(compare(key, string_or_infinity{"m", false}, float64_t(3.0)) == -1);
+  CHECK(compare(key, string_or_infinity{"m", false}, float64_t(2.5), decr<float64_t>{-2.0}) == -1);
+  CHECK(compare(key, string_or_infinity{"m", false}, float64_t(2.5)) == 1);
+  CHECK(compare_prefix(key, string_or_infinity{"m", false}, float64_t(2.5)) == 0);
+  CHECK_THROWS(compare(key, string_or_infinity{"m", false}, float64_t(NAN)));
+
+  bytes tk;
+  orderedcode::append(tk, string("a"), trailing_string{});
+  tk.push_back('x');
+  tk.push_back('y');
+  trailing_string t;
+  t.assign("x");
+  CHECK(compare(tk, string("a"), t) == 1);
+  CHECK(compare_prefix(tk, string("a"), t) == 0);
+  t.assign("xy");
+  CHECK(compare(tk, string("a"), t) == 0);
+  t.assign("xz");
+  CHECK(compare(tk, string("a"), t) == -1);
+  bytes dk;
+  orderedcode::append(dk, decr<trailing_string>{t});
+  CHECK(compare(dk, decr<trailing_string>{t}) == 0);
+  t.assign("xa");
+  CHECK(compare(dk, decr<trailing_string>{t}) == encoded_compare(dk, decr<trailing_string>{t}));
+  CHECK(compare(tk, "a") == 1);
+  CHECK(compare(bytes{}, "a") == -1);
+}
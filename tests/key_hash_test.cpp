@@ -0,0 +1,85 @@
+#include <key_hash.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <set>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("key hash: hash_key", "[noir][hash]") {
+  bytes b(100);
+  for (size_t i = 0; i < b.size(); i++) {
+    b[i] = byte_t(i * 37 + 1);
+  }
+  // every length hashes differently, including runs of zero bytes.
+  set<uint64_t> seen;
+  for (size_t n = 0; n <= b.size(); n++) {
+    seen.insert(hash_key(span<const byte_t>(b.data(), n)));
+  }
+  bytes zeros(24);
+  for (size_t n = 0; n <= zeros.size(); n++) {
+    seen.insert(hash_key(span<const byte_t>(zeros.data(), n)));
+  }
+  CHECK(seen.size() == b.size() + 1 + zeros.size());
+  CHECK(hash_key(b, 1) != hash_key(b));
+
+  // consuming the bytes in pieces gives the same hashes.
+  for (size_t cut = 0; cut <= b.size(); cut += 7) {
+    detail::hasher h;
+    auto t = h.update(b.data(), b.data() + cut);
+    CHECK(h.finish(t, b.data() + cut) == hash_key(span<const byte_t>(b.data(), cut)));
+    t = h.update(t, b.data() + b.size());
+    CHECK(h.finish(t, b.data() + b.size()) == hash_key(b));
+  }
+
+  // flipping any single bit changes about half of the output bits.
+  size_t flipped = 0;
+  for (size_t i = 0; i < 16 * 8; i++) {
+    bytes c(b.begin(), b.begin() + 16);
+    c[i / 8] ^= byte_t(1 << (i % 8));
+    flipped += popcount(hash_key(c) ^ hash_key(span<const byte_t>(b.data(), 16)));
+  }
+  CHECK(flipped > 16 * 8 * 28);
+  CHECK(flipped < 16 * 8 * 36);
+}
+
+TEST_CASE("key hash: append_hashed", "[noir][hash]") {
+  string x = str_const("users\x00\xff");
+  for (int64_t t : {int64_t(0), int64_t(-1), int64_t(1700000000)}) {
+    bytes want;
+    orderedcode::append(want, x, uint64_t(7), decr<int64_t>{t}, trailing_string{});
+    bytes prefix;
+    orderedcode::append(prefix, x, uint64_t(7));
+
+    bytes b = {1, 2, 3};
+    auto kh = append_hashed<2>(b, x, uint64_t(7), decr<int64_t>{t}, trailing_string{});
+    CHECK(bytes(b.begin() + 3, b.end()) == want);
+    CHECK(kh.full == hash_key(want));
+    CHECK(kh.prefix == hash_key(prefix));
+
+    std::string str;
+    CHECK(append_hashed<4>(str, x, uint64_t(7), decr<int64_t>{t}, trailing_string{}).prefix == kh.full);
+
+    key_builder kb;
+    CHECK(append_hashed(kb, x, uint64_t(7), decr<int64_t>{t}, trailing_string{}).prefix == hash_key({}));
+    auto tail = append_hashed(kb, int64_t(5));
+    CHECK(tail.full == hash_key(span<const byte_t>(kb.key()).subspan(want.size())));
+
+    bytes sb;
+    auto seeded = append_hashed<2>(sb, hash_seed{0x5eed}, x, uint64_t(7), decr<int64_t>{t}, trailing_string{});
+    CHECK(sb == want);
+    CHECK(seeded.full == hash_key(want, 0x5eed));
+    CHECK(seeded.prefix == hash_key(prefix, 0x5eed));
+    CHECK(seeded.full != kh.full);
+    std::string sstr;
+    CHECK(append_hashed(sstr, hash_seed{0x5eed}, x, uint64_t(7), decr<int64_t>{t}, trailing_string{}).full ==
+          seeded.full);
+    key_builder skb;
+    CHECK(append_hashed(skb, hash_seed{0x5eed}, x, uint64_t(7), decr<int64_t>{t}, trailing_string{}).full ==
+          seeded.full);
+  }
+
+  bytes b;
+  CHECK_THROWS(append_hashed<1>(b, string("a"), float64_t(NAN)));
+  CHECK(b.empty());
+}
@@ -0,0 +1,129 @@
+#include <key_template.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <thread>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("key template: stamp", "[noir][template]") {
+  key_template t(uint64_t(42), string(str_const("ta\x00ble")));
+  bytes prefix;
+  orderedcode::append(prefix, uint64_t(42), string(str_const("ta\x00ble")));
+  CHECK(bytes(t.prefix().begin(), t.prefix().end()) == prefix);
+
+  const byte_t* data = nullptr;
+  for (int64_t ts : {1700000000, -5, 0}) {
+    bytes want;
+    orderedcode::append(want, uint64_t(42), string(str_const("ta\x00ble")), decr<int64_t>{ts}, uint64_t(7));
+    auto k = t.stamp(decr<int64_t>{ts}, uint64_t(7));
+    CHECK(bytes(k.begin(), k.end()) == want);
+    if (ts == 1700000000) {
+      data = k.data();
+    }
+    CHECK(k.data() == data);
+
+    bytes out = {9};
+    container_sink<bytes> sink{out};
+    t.stamp_to(sink, decr<int64_t>{ts}, uint64_t(7));
+    CHECK(bytes(out.begin() + 1, out.end()) == want);
+  }
+
+  arena ar;
+  t.stamp_to(ar, uint64_t(1));
+  auto ak = ar.take();
+  CHECK(bytes(ak.begin(), ak.end() - 2) == prefix);
+  CHECK_THROWS(t.stamp(float64_t(NAN)));
+  auto k = t.stamp(uint64_t(1));
+  CHECK(bytes(k.begin(), k.end() - 2) == prefix);
+
+  t.reset();
+  CHECK(t.prefix().empty());
+  CHECK(t.stamp(infinity{}).size() == 2);
+}
+
+TEST_CASE("key template: cache", "[noir][template]") {
+  key_template_cache<uint64_t, string> cache(4);
+  for (int round = 0; round < 3; round++) {
+    for (uint64_t tenant = 0; tenant < 10; tenant++) {
+      bytes want;
+      orderedcode::append(want, tenant, "table" + to_string(tenant % 3), uint64_t(round));
+      auto k = cache.stamp(tenant, "table" + to_string(tenant % 3), uint64_t(round));
+      CHECK(bytes(k.begin(), k.end()) == want);
+
+      bytes out;
+      container_sink<bytes> sink{out};
+      cache.stamp_to(sink, tenant, "table" + to_string(tenant % 3), uint64_t(round));
+      CHECK(out == want);
+    }
+  }
+  auto a = cache.stamp(1, "x", uint64_t(1));
+  CHECK(cache.stamp(1, "x", uint64_t(2)).data() == a.data());
+
+  key_template_cache<decr<int64_t>, string_or_infinity> odd;
+  auto b = odd.stamp(decr<int64_t>{3}, string_or_infinity{"", true}, uint64_t(2));
+  auto c = odd.stamp(decr<int64_t>{3}, string_or_infinity{"", true}, uint64_t(1));
+  CHECK(b.data() == c.data());
+  bytes want;
+  orderedcode::append(want, decr<int64_t>{3}, string_or_infinity{"", true}, uint64_t(1));
+  CHECK(bytes(c.begin(), c.end()) == want);
+
+  key_template_cache<decr<string_view>> views;
+  auto d = views.stamp(decr<string_view>{string(32, 'v')}, uint64_t(2));
+  auto e = views.stamp(decr<string_view>{string(32, 'v')}, uint64_t(1));
+  CHECK(d.data() == e.data());
+  want.clear();
+  orderedcode::append(want, decr<string>{string(32, 'v')}, uint64_t(1));
+  CHECK(bytes(e.begin(), e.end()) == want);
+
+  vector<thread> threads;
+  vector<int> ok(4);
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&ok, i] {
+      ok[i] = 1;
+      for (uint64_t j = 0; j < 1000; j++) {
+        auto k = thread_key_templates<uint64_t, uint64_t>().stamp(uint64_t(i), j % 5, j);
+        bytes want;
+        orderedcode::append(want, uint64_t(i), j % 5, j);
+        ok[i] &= bytes(k.begin(), k.end()) == want;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  CHECK(ok == vector<int>(4, 1));
+}
+
+TEST_CASE("key template: cache collisions", "[noir][template]") {
+  // with one slot every distinct prefix evicts the previous one.
+  key_template_cache<uint64_t> one(1);
+  auto key = [](uint64_t p, uint64_t x) {
+    bytes b;
+    orderedcode::append(b, p, x);
+    return b;
+  };
+  auto k1 = one.stamp(1, uint64_t(9));
+  bytes first(k1.begin(), k1.end());
+  one.stamp(2, uint64_t(9));
+  auto k2 = one.stamp(1, uint64_t(9));
+  CHECK(first == key(1, 9));
+  CHECK(bytes(k2.begin(), k2.end()) == key(1, 9));
+
+  // a caller and a callee stamping through the same thread cache.
+  bytes outer, inner;
+  container_sink<bytes> os{outer}, is{inner};
+  auto& cache = thread_key_templates<uint64_t>();
+  for (uint64_t i = 0; i < 200; i++) {
+    outer.clear();
+    inner.clear();
+    cache.stamp_to(os, i % 7, i);
+    thread_key_templates<uint64_t>().stamp_to(is, i % 11 + 100, i);
+    cache.stamp_to(os, i % 7, i + 1);
+    bytes want = key(i % 7, i);
+    bytes next = key(i % 7, i + 1);
+    want.insert(want.end(), next.begin(), next.end());
+    CHECK(outer == want);
+    CHECK(inner == key(i % 11 + 100, i));
+  }
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <keyrange.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <types/str_const.h>
+#include <vector>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("keyrange: compare keys", "[noir][keyrange]") {
+  bytes a = {0x01, 0x02};
+  bytes b = {0x01, 0x02, 0x00};
+  bytes c = {0x01, 0x03};
+  bytes e;
+
+  CHECK(compare_keys(a, a) == 0);
+  CHECK(compare_keys(a, b) < 0);
+  CHECK(compare_keys(b, c) < 0);
+  CHECK(compare_keys(c, a) > 0);
+  CHECK(compare_keys(e, a) < 0);
+  CHECK(compare_keys(e, e) == 0);
+  CHECK(key_less{}(a, c));
+  CHECK(!key_less{}(c, a));
+}
+
+TEST_CASE("keyrange: prefix successor", "[noir][keyrange]") {
+  CHECK(prefix_successor(bytes{0x01, 0x02}) == bytes{0x01, 0x03});
+  CHECK(prefix_successor(bytes{0x01, 0xff, 0xff}) == bytes{0x02});
+  CHECK(prefix_successor(bytes{0xff, 0xff}).empty());
+  CHECK(prefix_successor(bytes{}).empty());
+}
+
+TEST_CASE("keyrange: prefix range", "[noir][keyrange]") {
+  vector<bytes> keys;
+  for (uint64_t t : {1, 2, 3}) {
+    for (string s : {string(""), string("a"), string(str_const("a\x00")), string("\xff"), string("b")}) {
+      for (int64_t ts : {-1, 0, 1, 300}) {
+        bytes k;
+        orderedcode::append(k, t, decr<string>{s}, decr<int64_t>{ts});
+        keys.push_back(k);
+        k.clear();
+        orderedcode::append(k, t, decr<string>{s}, infinity{});
+        keys.push_back(k);
+      }
+    }
+  }
+  std::sort(keys.begin(), keys.end(), key_less{});
+
+  auto count = [&](const key_range& r) {
+    return size_t(std::count_if(keys.begin(), keys.end(), [&](const bytes& k) { return contains(r, k); }));
+  };
+  CHECK(count(prefix_range()) == keys.size());
+  CHECK(count(prefix_range(uint64_t(2))) == keys.size() / 3);
+  CHECK(count(prefix_range(uint64_t(2), decr<string>{"a"})) == 8);
+  CHECK(count(prefix_range(uint64_t(2), decr<string>{"\xff"})) == 8);
+  CHECK(count(prefix_range(uint64_t(3), decr<string>{"b"}, decr<int64_t>{0})) == 1);
+  CHECK(count(prefix_range(uint64_t(4))) == 0);
+
+  auto r = prefix_range(uint64_t(1), decr<string>{""});
+  auto lo = std::lower_bound(keys.begin(), keys.end(), r.lo, key_less{});
+  auto hi = std::lower_bound(keys.begin(), keys.end(), r.hi, key_less{});
+  CHECK(hi - lo == 8);
+  for (auto it = lo; it != hi; it++) {
+    uint64_t t;
+    decr<string> s;
+    span<byte_t> sp(*it);
+    orderedcode::parse(sp, t, s);
+    CHECK(t == 1);
+    CHECK(s.val.empty());
+  }
+
+  bytes ab;
+  orderedcode::append(ab, uint64_t(1), trailing_string{"ab"});
+  auto tr = prefix_range(uint64_t(1), trailing_string{"a"});
+  CHECK(contains(tr, ab));
+  CHECK(!contains(prefix_range(uint64_t(1), trailing_string{"b"}), ab));
+}
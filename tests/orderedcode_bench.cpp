@@ -0,0 +1,529 @@
+#include <abbreviated_key.h>
+#include <cstdlib>
+#include <fstream>
+#include <key_compare.h>
+#include <key_hash.h>
+#include <key_template.h>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <libs/Catch2/src/catch2/reporters/catch_reporter_event_listener.hpp>
+#include <libs/Catch2/src/catch2/reporters/catch_reporter_registrars.hpp>
+#include <map>
+#include <orderedcode.h>
+#include <partition.h>
+#include <radix_sort.h>
+#include <random>
+#include <static_index.h>
+#include <vector>
+
+using namespace std;
+using namespace orderedcode;
+
+// Bytes handled per operation, by benchmark name; benchmarks registered through per_op report throughput.
+static map<string, size_t>& bytes_per_op() {
+  static map<string, size_t> m;
+  return m;
+}
+
+static string per_op(string name, size_t bytes) {
+  bytes_per_op()[name] = bytes;
+  return name;
+}
+
+// Collects the mean of every benchmark and writes "name,ns_per_op,bytes_per_op,bytes_per_s" rows to the
+// file named by ORDEREDCODE_BENCH_CSV when the run ends, so results can be tracked across releases.
+// Rows without a byte count leave the last two columns empty.
+class bench_csv : public Catch::EventListenerBase {
+public:
+  using Catch::EventListenerBase::EventListenerBase;
+
+  void benchmarkEnded(Catch::BenchmarkStats<> const& stats) override {
+    rows_.emplace_back(stats.info.name, stats.mean.point.count());
+  }
+
+  void testRunEnded(Catch::TestRunStats const&) override {
+    const char* path = getenv("ORDEREDCODE_BENCH_CSV");
+    if (path == nullptr || rows_.empty()) {
+      return;
+    }
+    ofstream out(path);
+    out << "name,ns_per_op,bytes_per_op,bytes_per_s\n";
+    for (auto& [name, ns] : rows_) {
+      string quoted = name;
+      for (size_t i = quoted.find('"'); i != string::npos; i = quoted.find('"', i + 2)) {
+        quoted.insert(i, 1, '"');
+      }
+      out << '"' << quoted << "\"," << ns << ',';
+      if (auto it = bytes_per_op().find(name); it != bytes_per_op().end() && ns > 0) {
+        out << it->second << ',' << uint64_t(double(it->second) * 1e9 / ns);
+      } else {
+        out << ',';
+      }
+      out << '\n';
+    }
+  }
+
+private:
+  vector<pair<string, double>> rows_;
+};
+
+CATCH_REGISTER_LISTENER(bench_csv)
+
+template<typename... Ts>
+static bytes encoded(const Ts&... xs) {
+  bytes b;
+  orderedcode::append(b, xs...);
+  return b;
+}
+
+TEST_CASE("orderedcode: append integer", "[noir][bench]") {
+  bytes b;
+  b.reserve(64);
+
+  for (uint64_t x : {uint64_t(0x7f), uint64_t(0x0a0b0c0d), uint64_t(0x0a0b0c0d0e0f), numeric_limits<uint64_t>::max()}) {
+    BENCHMARK(per_op("append uint64 " + to_string(x), encoded(x).size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+  }
+  for (int64_t x : {int64_t(-3), int64_t(100), int64_t(-0x0a0b0c0d), int64_t(0x0a0b0c0d0e0f),
+                    numeric_limits<int64_t>::max()}) {
+    BENCHMARK(per_op("append int64 " + to_string(x), encoded(x).size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+  }
+}
+
+TEST_CASE("orderedcode: append float64", "[noir][bench]") {
+  bytes b;
+  b.reserve(64);
+
+  for (float64_t x : {0.0, 1.0, 3.14159, -2.5e-300, 6.02e23}) {
+    BENCHMARK(per_op("append float64 " + to_string(x), encoded(x).size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+  }
+}
+
+TEST_CASE("orderedcode: parse numbers", "[noir][bench]") {
+  for (uint64_t x : {uint64_t(0x7f), uint64_t(0x0a0b0c0d), numeric_limits<uint64_t>::max()}) {
+    auto b = encoded(x);
+    uint64_t dst;
+    BENCHMARK(per_op("parse uint64 " + to_string(x), b.size())) {
+      span<byte_t> sp(b);
+      orderedcode::parse(sp, dst);
+      return dst;
+    };
+  }
+  for (int64_t x : {int64_t(-3), int64_t(-0x0a0b0c0d), numeric_limits<int64_t>::max()}) {
+    auto b = encoded(x);
+    int64_t dst;
+    BENCHMARK(per_op("parse int64 " + to_string(x), b.size())) {
+      span<byte_t> sp(b);
+      orderedcode::parse(sp, dst);
+      return dst;
+    };
+  }
+  for (float64_t x : {1.0, -2.5e-300, 6.02e23}) {
+    auto b = encoded(x);
+    float64_t dst;
+    BENCHMARK(per_op("parse float64 " + to_string(x), b.size())) {
+      span<byte_t> sp(b);
+      orderedcode::parse(sp, dst);
+      return dst;
+    };
+  }
+}
+
+// a string of n bytes with an escaped byte every `every` bytes (0 for none).
+static string escape_density(size_t every, size_t n = 4096) {
+  string x(n, 'k');
+  for (size_t i = every; every > 0 && i < x.size(); i += every) {
+    x[i] = i % 2 ? '\xff' : '\x00';
+  }
+  return x;
+}
+
+TEST_CASE("orderedcode: append string", "[noir][bench]") {
+  bytes b;
+  b.reserve(16384);
+
+  for (size_t every : {0, 1024, 64, 8, 1}) {
+    auto x = escape_density(every);
+    BENCHMARK(per_op("append string 4k, escape every " + to_string(every), encoded(x).size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+  }
+  for (size_t n : {0, 9, 64, 512}) {
+    auto x = escape_density(0, n);
+    BENCHMARK(per_op("append string " + to_string(n) + " bytes", encoded(x).size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+  }
+}
+
+TEST_CASE("orderedcode: parse string", "[noir][bench]") {
+  for (size_t every : {0, 64, 8}) {
+    auto x = escape_density(every);
+    auto b = encoded(x);
+    auto db = encoded(decr<string>{x});
+    string dst;
+    decr<string> ddst;
+
+    BENCHMARK(per_op("parse string 4k, escape every " + to_string(every), b.size())) {
+      span<byte_t> sp(b);
+      orderedcode::parse(sp, dst);
+      return dst.size();
+    };
+    BENCHMARK(per_op("parse decr<string> 4k, escape every " + to_string(every), db.size())) {
+      span<byte_t> sp(db);
+      orderedcode::parse(sp, ddst);
+      return ddst.val.size();
+    };
+  }
+  for (size_t n : {9, 64, 512}) {
+    auto b = encoded(escape_density(0, n));
+    string dst;
+    BENCHMARK(per_op("parse string " + to_string(n) + " bytes", b.size())) {
+      span<byte_t> sp(b);
+      orderedcode::parse(sp, dst);
+      return dst.size();
+    };
+  }
+}
+
+TEST_CASE("orderedcode: parse string views", "[noir][bench]") {
+  auto b = encoded(escape_density(0));
+  auto eb = encoded(escape_density(64));
+  string_ref ref;
+  arena mem;
+
+  BENCHMARK(per_op("parse string_ref 4k, no escapes", b.size())) {
+    span<byte_t> sp(b);
+    orderedcode::parse(sp, ref);
+    return ref.val.size();
+  };
+  BENCHMARK(per_op("parse string_ref 4k, escape every 64", eb.size())) {
+    span<byte_t> sp(eb);
+    orderedcode::parse(sp, ref);
+    return ref.val.size();
+  };
+  BENCHMARK(per_op("parse arena_string 4k, escape every 64", eb.size())) {
+    span<byte_t> sp(eb);
+    arena_string dst{&mem, {}};
+    orderedcode::parse(sp, increasing, dst);
+    mem.reset();
+    return dst.val.size();
+  };
+}
+
+TEST_CASE("orderedcode: string_or_infinity", "[noir][bench]") {
+  bytes b;
+  b.reserve(64);
+  string_or_infinity s{"user:1234", false};
+  string_or_infinity top{"", true};
+  auto sb = encoded(s);
+  auto ib = encoded(top);
+  string_or_infinity dst;
+
+  BENCHMARK(per_op("append string_or_infinity, string", sb.size())) {
+    b.clear();
+    orderedcode::append(b, s);
+    return b.size();
+  };
+  BENCHMARK(per_op("append string_or_infinity, infinity", ib.size())) {
+    b.clear();
+    orderedcode::append(b, top);
+    return b.size();
+  };
+  BENCHMARK(per_op("parse string_or_infinity, string", sb.size())) {
+    span<byte_t> sp(sb);
+    orderedcode::parse(sp, dst);
+    return dst.s.size();
+  };
+  BENCHMARK(per_op("parse string_or_infinity, infinity", ib.size())) {
+    span<byte_t> sp(ib);
+    orderedcode::parse(sp, dst);
+    return dst.inf;
+  };
+  BENCHMARK(per_op("try_parse string_or_infinity, string", sb.size())) {
+    span<byte_t> sp(sb);
+    return try_parse(sp, dst);
+  };
+}
+
+TEST_CASE("orderedcode: trailing string", "[noir][bench]") {
+  bytes b;
+  b.reserve(8192);
+
+  for (size_t n : {9, 4096}) {
+    trailing_string x;
+    x.assign(escape_density(64, n));
+    auto tb = encoded(x);
+    auto db = encoded(decr<trailing_string>{x});
+    trailing_string dst;
+    decr<trailing_string> ddst;
+
+    BENCHMARK(per_op("append trailing_string " + to_string(n) + " bytes", tb.size())) {
+      b.clear();
+      orderedcode::append(b, x);
+      return b.size();
+    };
+    BENCHMARK(per_op("parse trailing_string " + to_string(n) + " bytes", tb.size())) {
+      span<byte_t> sp(tb);
+      orderedcode::parse(sp, dst);
+      return dst.size();
+    };
+    BENCHMARK(per_op("parse decr<trailing_string> " + to_string(n) + " bytes", db.size())) {
+      span<byte_t> sp(db);
+      orderedcode::parse(sp, ddst);
+      return ddst.val.size();
+    };
+  }
+}
+
+TEST_CASE("orderedcode: tuple", "[noir][bench]") {
+  string x = "users";
+  bytes b;
+  size_t n = encoded(x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42)).size();
+
+  BENCHMARK(per_op("append tuple into fresh bytes", n)) {
+    bytes k;
+    orderedcode::append(k, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+    return k.size();
+  };
+  BENCHMARK(per_op("append tuple into reused bytes", n)) {
+    b.clear();
+    orderedcode::append(b, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+    return b.size();
+  };
+  BENCHMARK(per_op("encode tuple into std::array", n)) {
+    array<byte_t, 64> a;
+    return encode(a, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+  };
+
+  auto tb = encoded(x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+  string s;
+  uint64_t i1, i2;
+  decr<int64_t> d;
+  BENCHMARK(per_op("parse tuple", tb.size())) {
+    span<byte_t> sp(tb);
+    orderedcode::parse(sp, s, i1, d, i2);
+    return i2;
+  };
+}
+
+TEST_CASE("orderedcode: append into sinks", "[noir][bench]") {
+  string x = "users";
+  std::string str;
+  arena ar;
+  size_t n = encoded(x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42)).size();
+
+  BENCHMARK(per_op("append tuple into reused std::string", n)) {
+    str.clear();
+    orderedcode::append(str, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+    return str.size();
+  };
+  BENCHMARK(per_op("append tuple into arena", n)) {
+    orderedcode::append(ar, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+    return ar.take().size();
+  };
+}
+
+TEST_CASE("orderedcode: key builder fan-out", "[noir][bench]") {
+  string x = "users";
+  key_builder kb;
+  size_t n = encoded(x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42)).size();
+
+  BENCHMARK(per_op("key_builder 16 suffixes on a shared prefix", 16 * n)) {
+    kb.clear();
+    kb.append(x, uint64_t(7));
+    auto m = kb.mark();
+    size_t total = 0;
+    for (int64_t t = 0; t < 16; t++) {
+      kb.truncate(m);
+      kb.append(decr<int64_t>{1700000000 + t}, uint64_t(42));
+      total += kb.size();
+    }
+    return total;
+  };
+}
+
+TEST_CASE("orderedcode: encode and hash", "[noir][bench]") {
+  string x = "users/" + string(40, 'k');
+  bytes b;
+  size_t n = encoded(x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42)).size();
+
+  BENCHMARK(per_op("append then hash_key", n)) {
+    b.clear();
+    orderedcode::append(b, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42));
+    return hash_key(b);
+  };
+  BENCHMARK(per_op("append_hashed with a 2-field prefix", n)) {
+    b.clear();
+    return append_hashed<2>(b, x, uint64_t(7), decr<int64_t>{1700000000}, uint64_t(42)).full;
+  };
+}
+
+TEST_CASE("orderedcode: key templates", "[noir][bench]") {
+  string table = "orders/" + string(24, 't');
+  bytes b;
+  size_t n = encoded(uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42)).size();
+  key_template t(uint64_t(90210), table);
+
+  BENCHMARK(per_op("append all four fields", n)) {
+    b.clear();
+    orderedcode::append(b, uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42));
+    return b.size();
+  };
+  BENCHMARK(per_op("stamp two fields onto a template", n)) {
+    return t.stamp(decr<int64_t>{1700000000}, uint64_t(42)).size();
+  };
+  BENCHMARK(per_op("stamp through thread_key_templates", n)) {
+    return thread_key_templates<uint64_t, string>()
+        .stamp(uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42))
+        .size();
+  };
+}
+
+TEST_CASE("orderedcode: compare against a probe", "[noir][bench]") {
+  string table = "orders/" + string(24, 't');
+  auto key = encoded(uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42));
+  bytes b;
+
+  BENCHMARK(per_op("append probe then compare_keys, differs in field 1", key.size())) {
+    b.clear();
+    orderedcode::append(b, uint64_t(90211), table, decr<int64_t>{1700000000}, uint64_t(42));
+    return compare_keys(key, b);
+  };
+  BENCHMARK(per_op("compare, differs in field 1", key.size())) {
+    return compare(key, uint64_t(90211), table, decr<int64_t>{1700000000}, uint64_t(42));
+  };
+  BENCHMARK(per_op("append probe then compare_keys, equal", key.size())) {
+    b.clear();
+    orderedcode::append(b, uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42));
+    return compare_keys(key, b);
+  };
+  BENCHMARK(per_op("compare, equal", key.size())) {
+    return compare(key, uint64_t(90210), table, decr<int64_t>{1700000000}, uint64_t(42));
+  };
+}
+
+TEST_CASE("orderedcode: decr", "[noir][bench]") {
+  auto x = escape_density(64);
+  bytes b;
+  b.reserve(16384);
+  auto ib = encoded(decr<int64_t>{1700000000});
+  decr<int64_t> dst;
+
+  BENCHMARK(per_op("append decr<int64>", ib.size())) {
+    b.clear();
+    orderedcode::append(b, decr<int64_t>{1700000000});
+    return b.size();
+  };
+  BENCHMARK(per_op("parse decr<int64>", ib.size())) {
+    span<byte_t> sp(ib);
+    orderedcode::parse(sp, dst);
+    return dst.val;
+  };
+  BENCHMARK(per_op("append decr<float64>", encoded(decr<float64_t>{-2.5}).size())) {
+    b.clear();
+    orderedcode::append(b, decr<float64_t>{-2.5});
+    return b.size();
+  };
+  BENCHMARK(per_op("append decr<string> 4k, escape every 64", encoded(decr<string>{x}).size())) {
+    b.clear();
+    orderedcode::append(b, decr<string>{x});
+    return b.size();
+  };
+}
+
+TEST_CASE("orderedcode: sort keys", "[noir][bench]") {
+  mt19937_64 rng(7);
+  vector<bytes> keys;
+  size_t total = 0;
+  for (size_t i = 0; i < 100000; i++) {
+    keys.push_back(encoded(uint64_t(rng() % 16), "table" + to_string(rng() % 100),
+                           decr<int64_t>{1700000000 + int64_t(rng() % 1000000)}, rng()));
+    total += keys.back().size();
+  }
+  vector<span<byte_t>> views(keys.begin(), keys.end());
+
+  BENCHMARK_ADVANCED(per_op("std::sort 100k mixed keys", total))(Catch::Benchmark::Chronometer meter) {
+    vector<vector<span<byte_t>>> runs(meter.runs(), views);
+    meter.measure([&](int i) { std::sort(runs[i].begin(), runs[i].end(), key_less{}); });
+  };
+  BENCHMARK_ADVANCED(per_op("abbreviated_sort 100k mixed keys", total))(Catch::Benchmark::Chronometer meter) {
+    vector<vector<span<byte_t>>> runs(meter.runs(), views);
+    meter.measure([&](int i) { abbreviated_sort(runs[i].begin(), runs[i].end()); });
+  };
+  BENCHMARK_ADVANCED(per_op("radix_sort 100k mixed keys", total))(Catch::Benchmark::Chronometer meter) {
+    vector<vector<span<byte_t>>> runs(meter.runs(), views);
+    meter.measure([&](int i) { radix_sort(runs[i].begin(), runs[i].end()); });
+  };
+  BENCHMARK_ADVANCED(per_op("parallel radix_sort 100k mixed keys", total))(Catch::Benchmark::Chronometer meter) {
+    vector<vector<span<byte_t>>> runs(meter.runs(), views);
+    meter.measure([&](int i) { radix_sort(runs[i].begin(), runs[i].end(), 0); });
+  };
+  thread_pool pool;
+  BENCHMARK_ADVANCED(per_op("pooled radix_sort 100k mixed keys", total))(Catch::Benchmark::Chronometer meter) {
+    vector<vector<span<byte_t>>> runs(meter.runs(), views);
+    meter.measure([&](int i) { radix_sort(runs[i].begin(), runs[i].end(), pool); });
+  };
+}
+
+TEST_CASE("orderedcode: route keys", "[noir][bench]") {
+  mt19937_64 rng(7);
+  vector<bytes> keys;
+  size_t total = 0;
+  for (size_t i = 0; i < 100000; i++) {
+    keys.push_back(encoded(uint64_t(rng() % 16), "table" + to_string(rng() % 100), rng()));
+    total += keys.back().size();
+  }
+  key_router router(choose_splitters(keys, 64));
+
+  BENCHMARK(per_op("route 100k keys to 64 parts", total)) {
+    size_t sum = 0;
+    for (auto& k : keys) {
+      sum += router.route(k);
+    }
+    return sum;
+  };
+}
+
+TEST_CASE("orderedcode: point lookups", "[noir][bench]") {
+  mt19937_64 rng(7);
+  vector<bytes> keys;
+  for (size_t i = 0; i < 1000000; i++) {
+    keys.push_back(encoded(string("users"), uint64_t(rng() % 100000), "session" + to_string(rng() % 1000)));
+  }
+  std::sort(keys.begin(), keys.end(), key_less{});
+  static_index ix(keys.begin(), keys.end());
+  vector<bytes> probes;
+  for (size_t i = 0; i < 1000; i++) {
+    probes.push_back(keys[rng() % keys.size()]);
+  }
+
+  BENCHMARK("std::lower_bound over vector<bytes>, 1k probes into 1M keys") {
+    size_t sum = 0;
+    for (auto& p : probes) {
+      sum += std::lower_bound(keys.begin(), keys.end(), p, key_less{}) - keys.begin();
+    }
+    return sum;
+  };
+  BENCHMARK("static_index lower_bound, 1k probes into 1M keys") {
+    size_t sum = 0;
+    for (auto& p : probes) {
+      sum += ix.lower_bound(p);
+    }
+    return sum;
+  };
+}
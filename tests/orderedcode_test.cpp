@@ -1,5 +1,6 @@
 #include <libs/Catch2/src/catch2/catch_all.hpp>
 #include <map>
+#include <memory>
 #include <orderedcode.h>
 #include <types/str_const.h>
 #include <vector>
@@ -478,3 +479,406 @@ TEST_CASE("orderedcode: NaN", "[noir][codec]") {
 
   CHECK(isnan(f));
 }
+
+TEST_CASE("orderedcode: escape scan", "[noir][codec]") {
+  vector<detail::find_special_fn> fns = {detail::find_special_scalar, detail::find_special};
+#ifdef ORDEREDCODE_X86
+  fns.push_back(detail::find_special_sse2);
+  if (detail::has_avx2()) {
+    fns.push_back(detail::find_special_avx2);
+  }
+#endif
+
+  for (size_t n = 0; n < 80; n++) {
+    for (size_t at = 0; at <= n; at++) {
+      for (byte_t c : {byte_t(0x00), byte_t(0xff)}) {
+        bytes b(n, 'a');
+        if (at < n) {
+          b[at] = c;
+          if (at + 1 < n) {
+            b[at + 1] = c ^ 0xff;
+          }
+        }
+        for (auto fn : fns) {
+          CHECK(fn(b.data(), b.data() + n) == b.data() + at);
+        }
+      }
+    }
+  }
+
+  string x(100, 'x');
+  x[3] = '\x00';
+  x[40] = '\xff';
+  x[41] = '\x00';
+  x[99] = '\xff';
+  bytes b;
+  orderedcode::append(b, x);
+  CHECK(b.size() == 100 + 4 + 2);
+  string y;
+  span<byte_t> sp(b);
+  orderedcode::parse(sp, y);
+  CHECK(x == y);
+  CHECK(sp.empty());
+}
+
+TEST_CASE("orderedcode: parse long string", "[noir][codec]") {
+  for (size_t n : {15, 16, 17, 31, 32, 33, 100, 1000}) {
+    string x;
+    for (size_t i = 0; i < n; i++) {
+      x.push_back(static_cast<char>(i * 37));
+    }
+    bytes b;
+    orderedcode::append(b, x, decr<string>{x}, uint64_t(7));
+
+    string y;
+    decr<string> dy;
+    uint64_t z;
+    span<byte_t> sp(b);
+    orderedcode::parse(sp, y, dy, z);
+    CHECK(x == y);
+    CHECK(x == dy.val);
+    CHECK(z == 7);
+    CHECK(sp.empty());
+  }
+
+  bytes b = {'f', 'o', 'o', 0x00, 0x02};
+  span<byte_t> s(b);
+  string x;
+  CHECK_THROWS(parse(s, x));
+
+  bytes b2 = {'f', 'o', 'o', 0xff, 0x01, 0x00, 0x01};
+  span<byte_t> s2(b2);
+  CHECK_THROWS(parse(s2, x));
+
+  bytes b3(40, 'a');
+  span<byte_t> s3(b3);
+  CHECK_THROWS(parse(s3, x));
+}
+
+TEST_CASE("orderedcode: parse string_ref", "[noir][codec]") {
+  bytes b;
+  orderedcode::append(b, string("foo"), string(str_const("b\x00r")), decr<string>{"baz"}, uint64_t(1));
+
+  string_ref r1, r2;
+  decr<string_ref> r3;
+  uint64_t i;
+  span<byte_t> sp(b);
+  orderedcode::parse(sp, r1, r2, r3, i);
+
+  CHECK(r1.val == "foo");
+  CHECK(!r1.copied);
+  CHECK(reinterpret_cast<const byte_t*>(r1.val.data()) == b.data());
+  CHECK(r2.val == string(str_const("b\x00r")));
+  CHECK(r2.copied);
+  CHECK(r3.val.val == "baz");
+  CHECK(r3.val.copied);
+  CHECK(i == 1);
+  CHECK(sp.empty());
+
+  // copies and moves of an unescaped value own their view.
+  auto copy = std::make_unique<string_ref>(r2);
+  string_ref moved(std::move(r2));
+  r2.scratch.assign("changed");
+  CHECK(copy->val == string(str_const("b\x00r")));
+  CHECK(moved.val == string(str_const("b\x00r")));
+  string_ref assigned;
+  assigned = *copy;
+  copy.reset();
+  CHECK(assigned.val == string(str_const("b\x00r")));
+  CHECK(assigned.copied);
+  string_ref borrowed = r1;
+  CHECK(borrowed.val.data() == r1.val.data());
+
+  bytes b2 = {'f', 'o', 'o'};
+  span<byte_t> sp2(b2);
+  CHECK_THROWS(parse(sp2, r1));
+}
+
+TEST_CASE("orderedcode: parse arena_string", "[noir][codec]") {
+  bytes b;
+  orderedcode::append(b, string("foo"), string(str_const("b\x00r")), decr<string>{"baz"}, uint64_t(1));
+
+  arena mem(16);
+  arena_string r1{&mem, {}}, r2{&mem, {}};
+  decr<arena_string> r3{{&mem, {}}};
+  uint64_t i;
+  span<byte_t> sp(b);
+  orderedcode::parse(sp, r1, r2, r3, i);
+
+  CHECK(r1.val == "foo");
+  CHECK(reinterpret_cast<const byte_t*>(r1.val.data()) == b.data());
+  CHECK(r2.val == string(str_const("b\x00r")));
+  CHECK(r3.val.val == "baz");
+  CHECK(i == 1);
+  CHECK(sp.empty());
+
+  // later values do not disturb earlier views, even across blocks.
+  vector<string> want;
+  vector<string_view> got;
+  for (int k = 0; k < 50; k++) {
+    string v = "value " + to_string(k) + string(str_const("\xff"));
+    bytes e;
+    orderedcode::append(e, v);
+    span<byte_t> es(e);
+    arena_string a{&mem, {}};
+    orderedcode::parse(es, increasing, a);
+    want.push_back(v);
+    got.push_back(a.val);
+  }
+  for (size_t k = 0; k < want.size(); k++) {
+    CHECK(got[k] == want[k]);
+  }
+  mem.reset();
+
+  bytes b2 = {'f', 'o', 0xff, 0x00, 'o'};
+  span<byte_t> sp2(b2);
+  CHECK_THROWS(parse(sp2, r1));
+  CHECK(mem.take().empty());
+
+  // a field in front of a large block only takes room for itself.
+  bytes big;
+  orderedcode::append(big, string(str_const("a\x00b")), string(100000, 'x'));
+  arena small(64);
+  span<byte_t> bs(big);
+  arena_string r4{&small, {}};
+  orderedcode::parse(bs, increasing, r4);
+  CHECK(r4.val == string(str_const("a\x00b")));
+  CHECK(small.prepare(0).size() <= 64);
+}
+
+TEST_CASE("orderedcode: try_parse", "[noir][codec]") {
+  bytes b;
+  orderedcode::append(b, uint64_t(7), int64_t(-1000), string("foo"), infinity{}, decr<float64_t>{1.5});
+
+  uint64_t i;
+  int64_t i2;
+  string_or_infinity s1, s2;
+  decr<float64_t> df;
+  span<byte_t> sp(b);
+  CHECK(try_parse(sp, i, i2, s1, s2, df) == status::ok);
+  CHECK(sp.empty());
+  CHECK(i == 7);
+  CHECK(i2 == -1000);
+  CHECK(!s1.inf);
+  CHECK(s1.s == "foo");
+  CHECK(s2.inf);
+  CHECK(df.val == 1.5);
+
+  bytes b2 = {0xff, 0xc0, 0x7f};
+  span<byte_t> sp2(b2);
+  CHECK(try_parse(sp2, i2) == status::corrupt);
+  CHECK(sp2.size() == 3);
+
+  bytes b3 = {0x03, 0x01};
+  span<byte_t> sp3(b3);
+  CHECK(try_parse(sp3, i) == status::corrupt);
+  CHECK(sp3.size() == 2);
+
+  bytes b5;
+  orderedcode::append(b5, uint64_t(7));
+  b5.insert(b5.end(), b3.begin(), b3.end());
+  span<byte_t> sp5(b5);
+  uint64_t j = 0;
+  CHECK(try_parse(sp5, i, j) == status::corrupt);
+  CHECK(sp5.size() == b5.size());
+
+  uint64_t n = 0x7FF8000000000001;
+  float64_t f;
+  memcpy(&f, &n, sizeof(n));
+  auto ni = int64_t(n);
+  bytes b4;
+  orderedcode::append(b4, ni);
+  span<byte_t> sp4(b4);
+  CHECK(try_parse(sp4, f) == status::nan);
+  CHECK(sp4.size() == b4.size());
+  CHECK_THROWS(parse(sp4, f));
+}
+
+TEST_CASE("orderedcode: encoded size and encode", "[noir][codec]") {
+  static_assert(max_encoded_size<uint64_t, decr<int64_t>, float64_t, infinity> == 9 + 10 + 10 + 2);
+  static_assert(encoded_size(uint64_t(0)) == 1);
+  static_assert(encoded_size(uint64_t(256)) == 3);
+  static_assert(encoded_size(int64_t(-65)) == 2);
+  static_assert(encoded_size(numeric_limits<int64_t>::max()) == 10);
+  static_assert(encoded_size(uint64_t(1), decr<int64_t>{8192}, infinity{}) == 2 + 3 + 2);
+  static_assert(encoded_size(string_or_infinity{"", true}) == 2);
+  static_assert(encoded_size(trailing_string{"abc"}) == 3);
+
+  string x = str_const("f\x00o\xff");
+  auto f = float64_t(-2.71828);
+  string_or_infinity si{"", true};
+  bytes b;
+  orderedcode::append(b, uint64_t(1025), x, decr<string>{x}, f, si, int64_t(-8193), trailing_string{x});
+  CHECK(b.size() == encoded_size(uint64_t(1025), x, decr<string>{x}, f, si, int64_t(-8193), trailing_string{x}));
+
+  bytes b2;
+  orderedcode::append(b2, uint64_t(1025));
+  orderedcode::append(b2, x);
+  orderedcode::append(b2, decr<string>{x});
+  orderedcode::append(b2, f);
+  orderedcode::append(b2, si);
+  orderedcode::append(b2, int64_t(-8193));
+  orderedcode::append(b2, trailing_string{x});
+  CHECK(b == b2);
+
+  array<byte_t, 64> a{};
+  auto n = encode(a, uint64_t(1025), x, decr<string>{x}, f, si, int64_t(-8193), trailing_string{x});
+  CHECK(bytes(a.begin(), a.begin() + n) == b);
+
+  // the last field lands at the very end of the buffer, without room for any slack.
+  bytes b3;
+  orderedcode::append(b3, x, numeric_limits<int64_t>::min());
+  bytes b4(b3.size(), 0xaa);
+  CHECK(encode(b4, x, numeric_limits<int64_t>::min()) == b3.size());
+  CHECK(b3 == b4);
+
+  array<byte_t, 4> small{};
+  CHECK_THROWS(encode(small, x));
+
+  uint64_t nan = 0x7FF8000000000001;
+  float64_t fnan;
+  memcpy(&fnan, &nan, sizeof(nan));
+  bytes b5 = {0x01};
+  CHECK_THROWS(append(b5, uint64_t(1), fnan));
+  CHECK(b5 == bytes{0x01});
+}
+
+TEST_CASE("orderedcode: sinks", "[noir][codec]") {
+  string x = str_const("a\x00z");
+  bytes b;
+  orderedcode::append(b, x, uint64_t(300), decr<int64_t>{-5});
+
+  std::string str = "pre";
+  orderedcode::append(str, x, uint64_t(300), decr<int64_t>{-5});
+  CHECK(str.substr(0, 3) == "pre");
+  CHECK(bytes(str.begin() + 3, str.end()) == b);
+
+  byte_t raw[32];
+  buffer_sink bs{{raw, sizeof(raw)}};
+  orderedcode::append(bs, x, uint64_t(300));
+  orderedcode::append(bs, decr<int64_t>{-5});
+  CHECK(bytes(raw, raw + bs.size) == b);
+
+  buffer_sink tiny{{raw, 3}};
+  CHECK_THROWS(append(tiny, x));
+  CHECK(tiny.size == 0);
+
+  arena ar(16);
+  vector<span<byte_t>> keys;
+  for (uint64_t i = 0; i < 100; i++) {
+    orderedcode::append(ar, x, i);
+    orderedcode::append(ar, decr<uint64_t>{i});
+    keys.push_back(ar.take());
+  }
+  for (uint64_t i = 0; i < 100; i++) {
+    string y;
+    uint64_t j;
+    decr<uint64_t> di;
+    orderedcode::parse(keys[i], y, j, di);
+    CHECK(y == x);
+    CHECK(j == i);
+    CHECK(di.val == i);
+    CHECK(keys[i].empty());
+  }
+  ar.reset();
+  orderedcode::append(ar, infinity{}, infinity{});
+  CHECK(ar.take().size() == 4);
+}
+
+TEST_CASE("orderedcode: key builder", "[noir][codec]") {
+  key_builder kb;
+  kb.append(string("users"), uint64_t(7));
+  auto m = kb.mark();
+  CHECK(kb.size() == m);
+
+  const byte_t* data = nullptr;
+  for (int64_t t : {1, -300, 1700000000, 2}) {
+    kb.truncate(m);
+    kb.append(decr<int64_t>{t}, string(str_const("x\xff")));
+    bytes want;
+    orderedcode::append(want, string("users"), uint64_t(7), decr<int64_t>{t}, string(str_const("x\xff")));
+    CHECK(bytes(kb.key().begin(), kb.key().end()) == want);
+    if (t == 1700000000) {
+      data = kb.key().data();
+    }
+  }
+  // the buffer has grown to the longest key, so shorter keys no longer reallocate.
+  CHECK(kb.key().data() == data);
+
+  key_builder kb2(4);
+  kb2.append_encoded(kb.key()).append(uint64_t(1));
+  bytes want(kb.key().begin(), kb.key().end());
+  orderedcode::append(want, uint64_t(1));
+  CHECK(bytes(kb2.key().begin(), kb2.key().end()) == want);
+
+  CHECK_THROWS(kb.append(string("a"), float64_t(NAN)));
+  CHECK(bytes(kb.key().begin(), kb.key().end()) == bytes(kb2.key().begin(), kb2.key().end() - 2));
+  CHECK_THROWS(kb.truncate(kb.size() + 1));
+  kb.clear();
+  CHECK(kb.empty());
+}
+
+TEST_CASE("orderedcode: fused decreasing", "[noir][codec]") {
+  string x;
+  for (size_t i = 0; i < 70; i++) {
+    x.push_back(static_cast<char>(i * 11));
+  }
+  auto check = [](auto v) {
+    bytes b;
+    orderedcode::append(b, v, uint64_t(1));
+    b.pop_back();
+    b.pop_back();
+    span<byte_t> sp(b);
+    invert(sp);
+    bytes d;
+    orderedcode::append(d, decr<decltype(v)>{v}, uint64_t(1));
+    d.pop_back();
+    d.pop_back();
+    CHECK(b == d);
+  };
+  check(uint64_t(0));
+  check(uint64_t(0x0102030405));
+  check(int64_t(-3));
+  check(int64_t(8192));
+  check(numeric_limits<int64_t>::min());
+  check(numeric_limits<int64_t>::max());
+  check(float64_t(-2.5));
+  check(x);
+  check(infinity{});
+  check(string_or_infinity{x, false});
+
+  bytes t(x.begin(), x.end());
+  orderedcode::append(t, decr<trailing_string>{x});
+  span<byte_t> sp(t);
+  sp = sp.subspan(x.size());
+  auto copy = bytes(sp.begin(), sp.end());
+  decr<trailing_string> dt;
+  orderedcode::parse(sp, dt);
+  CHECK(dt.val == x);
+  CHECK(bytes(sp.begin(), sp.end()) == copy);
+}
+
+TEST_CASE("orderedcode: constant key", "[noir][codec]") {
+  constexpr auto users = constant_key([] { return std::tuple{"users", uint64_t(7)}; });
+  static_assert(users.size() == 5 + 2 + 2);
+  static_assert(users[5] == 0x00 && users[6] == 0x01 && users[7] == 0x01 && users[8] == 0x07);
+
+  constexpr auto mixed = constant_key([] {
+    return std::tuple{std::string_view("a\0\xff", 3), decr<std::string_view>{"b"}, int64_t(-8193), infinity{},
+                      decr<infinity>{}, decr<uint64_t>{516}, float64_t(1.5)};
+  });
+  bytes want;
+  orderedcode::append(want, string(str_const("a\x00\xff")), decr<string>{"b"}, int64_t(-8193), infinity{},
+                      decr<infinity>{}, decr<uint64_t>{516}, float64_t(1.5));
+  CHECK(bytes(mixed.begin(), mixed.end()) == want);
+
+  bytes k(users.begin(), users.end());
+  orderedcode::append(k, decr<int64_t>{1700000000});
+  bytes k2;
+  orderedcode::append(k2, string("users"), uint64_t(7), decr<int64_t>{1700000000});
+  CHECK(k == k2);
+
+  bytes lit;
+  orderedcode::append(lit, "users", uint64_t(7));
+  CHECK(bytes(users.begin(), users.end()) == lit);
+}
@@ -0,0 +1,4 @@
+// Built into partition_test next to partition_test.cpp, so that partition.h, static_index.h and the
+// headers under them are checked to link when included from more than one file.
+#include <partition.h>
+#include <static_index.h>
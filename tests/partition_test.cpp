@@ -0,0 +1,97 @@
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <partition.h>
+#include <random>
+
+using namespace std;
+using namespace orderedcode;
+
+TEST_CASE("partition: splitters balance rows", "[noir][partition]") {
+  mt19937_64 rng(11);
+  vector<bytes> keys;
+  for (size_t i = 0; i < 100000; i++) {
+    // skewed: most keys fall in a few tables.
+    uint64_t table = rng() % 100 < 80 ? rng() % 3 : rng() % 1000;
+    bytes k;
+    orderedcode::append(k, table, decr<int64_t>{int64_t(rng() % 1000000)}, to_string(rng() % 1000));
+    keys.push_back(k);
+  }
+  key_sampler sampler(4000);
+  for (auto& k : keys) {
+    sampler.add(k);
+  }
+  CHECK(sampler.seen() == keys.size());
+  CHECK(sampler.sample().size() == 4000);
+
+  size_t parts = 16;
+  key_router router(choose_splitters(sampler.sample(), parts));
+  REQUIRE(router.parts() == parts);
+
+  vector<size_t> count(parts);
+  for (auto& k : keys) {
+    size_t p = router.route(k);
+    count[p]++;
+    auto& s = router.splitters();
+    CHECK(size_t(upper_bound(s.begin(), s.end(), k, key_less{}) - s.begin()) == p);
+    CHECK(contains(router.range(p), k));
+  }
+  for (size_t c : count) {
+    CHECK(c > keys.size() / parts * 3 / 4);
+    CHECK(c < keys.size() / parts * 5 / 4);
+  }
+}
+
+TEST_CASE("partition: splitters balance bytes", "[noir][partition]") {
+  vector<bytes> keys;
+  for (size_t i = 0; i < 1000; i++) {
+    bytes k;
+    // the upper half of the keys is ten times longer.
+    orderedcode::append(k, uint64_t(i), string(i < 500 ? 10 : 100, 'x'));
+    keys.push_back(k);
+  }
+  auto by_rows = choose_splitters(keys, 2);
+  auto by_bytes = choose_splitters(keys, 2, weigh_by::bytes);
+  REQUIRE(by_rows.size() == 1);
+  REQUIRE(by_bytes.size() == 1);
+  key_router rows(by_rows), bytes_router(by_bytes);
+  CHECK(rows.route(keys[499]) == 0);
+  CHECK(rows.route(keys[500]) == 1);
+  // by bytes the split moves into the long keys, where each half holds about as many bytes.
+  size_t first = 0, total = 0;
+  for (auto& k : keys) {
+    first += bytes_router.route(k) == 0 ? k.size() : 0;
+    total += k.size();
+  }
+  CHECK(bytes_router.route(keys[600]) == 0);
+  CHECK(bytes_router.route(keys[800]) == 1);
+  CHECK(first * 2 > total * 49 / 50);
+  CHECK(first * 2 < total * 51 / 50);
+}
+
+TEST_CASE("partition: duplicates and edge cases", "[noir][partition]") {
+  bytes k;
+  orderedcode::append(k, string("same"));
+  vector<bytes> same(100, k);
+  CHECK(choose_splitters(same, 8).empty());
+  CHECK(choose_splitters({}, 8).empty());
+  CHECK(choose_splitters(same, 1).empty());
+  CHECK_THROWS(choose_splitters(same, 0));
+
+  // splitters are the shortest separating prefixes.
+  vector<bytes> two = {{0x10, 0x20, 0x30}, {0x10, 0x21, 0x30}};
+  auto s = choose_splitters(two, 2);
+  REQUIRE(s.size() == 1);
+  CHECK(s[0] == bytes{0x10, 0x21});
+
+  key_router r({{0x10}, {0x10, 0x05}, {0x80}});
+  CHECK(r.route({}) == 0);
+  CHECK(r.route(bytes{0x0f, 0xff}) == 0);
+  CHECK(r.route(bytes{0x10}) == 1);
+  CHECK(r.route(bytes{0x10, 0x05}) == 2);
+  CHECK(r.route(bytes{0x7f}) == 2);
+  CHECK(r.route(bytes{0xff}) == 3);
+  CHECK(r.range(0).lo.empty());
+  CHECK(r.range(3).hi.empty());
+
+  CHECK_THROWS(key_router({{0x10}, {0x10}}));
+  CHECK_THROWS(key_router({bytes{}}));
+}
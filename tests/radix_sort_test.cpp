@@ -0,0 +1,66 @@
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <radix_sort.h>
+#include <random>
+
+using namespace std;
+using namespace orderedcode;
+
+static vector<bytes> mixed_keys(size_t n) {
+  mt19937_64 rng(42);
+  vector<bytes> keys;
+  for (size_t i = 0; i < n; i++) {
+    bytes k;
+    string s = "tbl" + to_string(rng() % 7);
+    if (rng() % 10 == 0) {
+      s.push_back('\0');
+    }
+    orderedcode::append(k, uint64_t(rng() % 3), s, decr<int64_t>{int64_t(rng() % 100000) - 50000}, rng() >> (rng() % 64));
+    keys.push_back(k);
+  }
+  // some duplicates and prefixes of other keys.
+  for (size_t i = 0; i < n / 10; i++) {
+    keys.push_back(keys[i]);
+    keys.push_back(bytes(keys[i].begin(), keys[i].begin() + keys[i].size() / 2));
+  }
+  shuffle(keys.begin(), keys.end(), rng);
+  return keys;
+}
+
+TEST_CASE("radix sort: matches std::sort", "[noir][radix]") {
+  thread_pool pool(3);
+  for (size_t n : {0, 1, 20, 500, 30000}) {
+    auto keys = mixed_keys(n);
+    auto want = keys;
+    std::sort(want.begin(), want.end());
+
+    auto got = keys;
+    radix_sort(got.begin(), got.end());
+    CHECK(got == want);
+
+    auto pgot = keys;
+    radix_sort(pgot.begin(), pgot.end(), 4);
+    CHECK(pgot == want);
+
+    pgot = keys;
+    radix_sort(pgot.begin(), pgot.end(), pool);
+    CHECK(pgot == want);
+  }
+}
+
+TEST_CASE("radix sort: spans and strings", "[noir][radix]") {
+  auto keys = mixed_keys(2000);
+  vector<span<byte_t>> views(keys.begin(), keys.end());
+  radix_sort(views.begin(), views.end());
+  CHECK(std::is_sorted(views.begin(), views.end(), key_less{}));
+
+  vector<string> strs;
+  for (auto& k : keys) {
+    strs.emplace_back(k.begin(), k.end());
+  }
+  auto want = strs;
+  std::sort(want.begin(), want.end(), [](const string& a, const string& b) {
+    return key_less{}(detail::key_view(a), detail::key_view(b));
+  });
+  radix_sort(strs.begin(), strs.end());
+  CHECK(strs == want);
+}
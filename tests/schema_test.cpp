@@ -0,0 +1,57 @@
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <schema.h>
+#include <types/str_const.h>
+
+using namespace std;
+using namespace orderedcode;
+
+using event_key = schema<uint64_t, decr<string>, int64_t, decr<float64_t>>;
+using fixed_key = schema<uint64_t, uint64_t, decr<int64_t>, infinity>;
+
+static_assert(!event_key::fixed_width);
+static_assert(fixed_key::fixed_width);
+static_assert(fixed_key::max_size() == 9 + 9 + 10 + 2);
+static_assert(event_key::directions[0] == increasing);
+static_assert(event_key::directions[1] == decreasing);
+static_assert(is_same_v<event_key::value_type, tuple<uint64_t, string, int64_t, float64_t>>);
+static_assert(schema<decr<decr<uint64_t>>>::directions[0] == increasing);
+
+TEST_CASE("schema: matches generic append", "[noir][schema]") {
+  string name = str_const("n\x00me");
+  bytes want;
+  orderedcode::append(want, uint64_t(7), decr<string>{name}, int64_t(-300), decr<float64_t>{1.5});
+
+  bytes b;
+  event_key::append(b, 7, name, -300, 1.5);
+  CHECK(b == want);
+  CHECK(event_key::encoded_size(7, name, -300, 1.5) == want.size());
+
+  std::string str;
+  event_key::append(str, 7, name, -300, 1.5);
+  CHECK(bytes(str.begin(), str.end()) == want);
+
+  span<byte_t> sp(b);
+  auto [id, n, delta, score] = event_key::decode(sp);
+  CHECK(sp.empty());
+  CHECK(id == 7);
+  CHECK(n == name);
+  CHECK(delta == -300);
+  CHECK(score == 1.5);
+}
+
+TEST_CASE("schema: fixed width", "[noir][schema]") {
+  array<byte_t, fixed_key::max_size()> buf;
+  auto n = fixed_key::encode(buf, numeric_limits<uint64_t>::max(), 0, numeric_limits<int64_t>::min(), infinity{});
+  CHECK(n == fixed_key::max_size() - 8);
+
+  span<byte_t> sp(buf.data(), n);
+  fixed_key::value_type v;
+  CHECK(fixed_key::try_decode(sp, v) == status::ok);
+  CHECK(get<0>(v) == numeric_limits<uint64_t>::max());
+  CHECK(get<2>(v) == numeric_limits<int64_t>::min());
+
+  span<byte_t> partial(buf.data(), n - 1);
+  CHECK(fixed_key::try_decode(partial, v) == status::corrupt);
+  CHECK(partial.size() == n - 1);
+  CHECK_THROWS(fixed_key::decode(partial));
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <libs/Catch2/src/catch2/catch_all.hpp>
+#include <random>
+#include <static_index.h>
+
+using namespace std;
+using namespace orderedcode;
+
+static size_t reference_lower_bound(const vector<bytes>& keys, span<const byte_t> k) {
+  return std::lower_bound(keys.begin(), keys.end(), k, key_less{}) - keys.begin();
+}
+
+TEST_CASE("static index: lookups", "[noir][index]") {
+  mt19937_64 rng(13);
+  for (size_t n : {0, 1, 7, 8, 9, 80, 81, 1000, 50000}) {
+    vector<bytes> keys;
+    for (size_t i = 0; i < n; i++) {
+      bytes k;
+      // a shared leading field, low-entropy strings and duplicates exercise the tie handling.
+      orderedcode::append(k, string("tbl"), uint64_t(rng() % 4), "user" + to_string(rng() % 50), uint64_t(rng() % 1000));
+      keys.push_back(k);
+    }
+    std::sort(keys.begin(), keys.end(), key_less{});
+    static_index ix(keys.begin(), keys.end());
+    REQUIRE(ix.size() == n);
+    for (size_t i = 0; i < n; i++) {
+      CHECK(bytes(ix[i].begin(), ix[i].end()) == keys[i]);
+    }
+
+    for (size_t t = 0; t < 2000; t++) {
+      bytes probe;
+      if (n > 0 && t % 2 == 0) {
+        probe = keys[rng() % n];
+        if (t % 4 == 0) {
+          probe.resize(rng() % (probe.size() + 1));
+        }
+      } else {
+        orderedcode::append(probe, string(rng() % 3 == 0 ? "tbl" : "tbm"), uint64_t(rng() % 5),
+                            "user" + to_string(rng() % 60));
+      }
+      size_t want = reference_lower_bound(keys, probe);
+      CHECK(ix.lower_bound(probe) == want);
+      bool found = want < n && keys[want] == probe;
+      CHECK(ix.find(probe) == (found ? want : n));
+    }
+  }
+}
+
+TEST_CASE("static index: ranges and edge cases", "[noir][index]") {
+  vector<bytes> keys;
+  for (uint64_t i = 0; i < 1000; i++) {
+    bytes k;
+    orderedcode::append(k, i / 100, decr<uint64_t>{i});
+    keys.push_back(k);
+  }
+  std::sort(keys.begin(), keys.end(), key_less{});
+  static_index ix(keys.begin(), keys.end());
+
+  auto [lo, hi] = ix.range(prefix_range(uint64_t(3)));
+  CHECK(hi - lo == 100);
+  for (size_t i = lo; i < hi; i++) {
+    span<byte_t> s(const_cast<byte_t*>(ix[i].data()), ix[i].size());
+    uint64_t a;
+    decr<uint64_t> b;
+    orderedcode::parse(s, a, b);
+    CHECK(a == 3);
+    CHECK(b.val == 399 - (i - lo));
+  }
+  auto all = ix.range({});
+  CHECK(all.first == 0);
+  CHECK(all.second == 1000);
+  CHECK(ix.range({keys[10], keys[5]}).second == ix.range({keys[10], keys[5]}).first);
+
+  vector<std::string> strs = {"", "a", string("a\0", 2), "a\xff", "b"};
+  static_index sx(strs.begin(), strs.end());
+  CHECK(sx.find(bytes{'a', 0}) == 2);
+  CHECK(sx.lower_bound(bytes{'a', 0, 0}) == 3);
+  CHECK(sx.find(bytes{}) == 0);
+  CHECK(sx.lower_bound(bytes{'c'}) == 5);
+
+  vector<bytes> same(20, bytes{1, 2, 3});
+  static_index dx(same.begin(), same.end());
+  CHECK(dx.lower_bound(bytes{1, 2, 3}) == 0);
+  CHECK(dx.lower_bound(bytes{1, 2}) == 0);
+  CHECK(dx.lower_bound(bytes{1, 2, 3, 0}) == 20);
+  CHECK(dx.lower_bound(bytes{1, 3}) == 20);
+
+  vector<bytes> unsorted = {{2}, {1}};
+  CHECK_THROWS(static_index(unsorted.begin(), unsorted.end()));
+  static_index ex;
+  CHECK(ex.lower_bound(bytes{1}) == 0);
+  CHECK(ex.find(bytes{1}) == 0);
+}